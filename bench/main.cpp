@@ -0,0 +1,24 @@
+// BroBash-bench: runs one naapo suite outside the shell, with the global operator new
+// replaced so AllocationCounter can count allocations. Kept out of src/ so the shell
+// itself always uses the standard allocator.
+#include "benchmark.h"
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+// Out of line, so the compiler never sees a `new` paired with this free().
+__attribute__((noinline)) void* operator new(size_t size) {
+    AllocationCounter::noteAllocation();
+    if (void* p = malloc(size ? size : 1)) return p;
+    throw bad_alloc();
+}
+__attribute__((noinline)) void operator delete(void* p) noexcept { free(p); }
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept { free(p); }
+
+int main(int argc, char** argv) {
+    AllocationCounter::enabled = true;
+    string arg;
+    for (int i = 1; i < argc; i++) arg += (i > 1 ? " " : "") + string(argv[i]);
+    printf("%s\n", naapoCommand(arg).c_str());
+    return 0;
+}
@@ -0,0 +1,46 @@
+#ifndef AHOCORASICK_H
+#define AHOCORASICK_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+using namespace std;
+
+// Aho-Corasick automaton for finding many literal patterns in one pass.
+// Bytes are first mapped to equivalence classes (every byte that occurs in no pattern
+// shares class 0), and the automaton is stored as a complete DFA: one dense row of
+// int32 next-states per state, classCount entries wide. Scanning is one table load
+// per input byte with no failure-link chasing.
+class AhoCorasick {
+public:
+    // Empty patterns are ignored; duplicates report under their first index.
+    explicit AhoCorasick(const vector<string>& patterns);
+
+    // Calls onMatch(patternIndex, endOffset) for every occurrence, in order of end offset
+    // (endOffset is one past the last byte). Stops early when onMatch returns false.
+    template <typename F>
+    void scan(const char* text, size_t size, F&& onMatch) const {
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(text);
+        int32_t state = 0;
+        for (size_t i = 0; i < size; i++) {
+            state = next[static_cast<size_t>(state) * classCount + byteClass[p[i]]];
+            for (int32_t s = hasOutput[state] ? state : -1; s >= 0; s = outputLink[s])
+                if (outputPattern[s] >= 0 && !onMatch(static_cast<size_t>(outputPattern[s]), i + 1)) return;
+        }
+    }
+
+    size_t stateCount() const { return outputPattern.size(); }
+    size_t tableBytes() const { return next.size() * sizeof(int32_t); }
+
+private:
+    uint8_t byteClass[256];
+    size_t classCount;
+    vector<int32_t> next;           // stateCount * classCount transitions
+    vector<int32_t> outputPattern;  // pattern ending exactly at this state, or -1
+    vector<int32_t> outputLink;     // nearest proper suffix state with an output, or -1
+    vector<uint8_t> hasOutput;      // outputPattern >= 0 or outputLink >= 0
+};
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+using namespace std;
+
+// Multi-file archive ("baandho"/"kholo"):
+//   "BBAR" | version u8 | 3 reserved bytes |
+//   members: one complete Huffman container per file, back to back |
+//   index: member count u32, then per member: path length u16 | path | offset u64 |
+//          compressed size u64 | original size u64 |
+//   footer: index offset u64 | "BBIX"
+// The trailing index lets a single member be located and decompressed without
+// touching the others. All integers are little-endian.
+struct ArchiveMember {
+    string path;
+    uint64_t offset;
+    uint64_t compressedSize;
+    uint64_t originalSize;
+};
+
+const size_t ARCHIVE_HEADER_SIZE = 8;
+const size_t ARCHIVE_FOOTER_SIZE = 12;
+
+// True for a relative path with no ".." component: one that stays inside the directory it
+// is extracted into. Only such paths are archived or extracted under their own name.
+bool isSafeMemberPath(const string& path);
+
+// Compresses baseDir/<path> for every path (relative to baseDir) on `threads` workers and
+// writes the archive; members are written in the given order. Files that cannot be read,
+// and paths isSafeMemberPath rejects, are skipped and listed in `skipped`.
+bool writeArchive(const string& archivePath, const string& baseDir, const vector<string>& paths,
+                  size_t threads, uint8_t codec, vector<ArchiveMember>& written, vector<string>& skipped);
+
+bool isArchive(const string& archivePath);
+bool readArchiveIndex(const string& archivePath, vector<ArchiveMember>& index);
+// Reads and decompresses one member, seeking straight to it through the index.
+bool readArchiveMember(const string& archivePath, const string& memberPath, string& content);
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <string>
+#include <cstddef>
+
+using namespace std;
+
+// Counts the operator new calls this thread makes while it is alive (nested counters
+// only count into the innermost). Allocations on other threads (pool workers, the
+// prefetcher) are never counted. Only BroBash-bench (bench/main.cpp) replaces the global
+// operator new to call noteAllocation() and sets `enabled`; the shell keeps the standard
+// allocator, and its naapo reports show allocations as "n/a".
+class AllocationCounter {
+public:
+    AllocationCounter();
+    ~AllocationCounter();
+    AllocationCounter(const AllocationCounter&) = delete;
+    AllocationCounter& operator=(const AllocationCounter&) = delete;
+
+    static bool enabled;
+    static void noteAllocation();
+
+    size_t count = 0;
+
+private:
+    size_t* previous;
+};
+
+// "naapo <suite> [args]": in-terminal micro-benchmarks comparing the current kernels
+// against the implementations they replaced.
+string naapoCommand(const string& arg);
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef BKTREE_H
+#define BKTREE_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+using namespace std;
+
+// Levenshtein distance between a and b if it is at most bound, otherwise bound + 1.
+// When the shorter word fits in 64 bytes (names nearly always do) a whole DP column is one
+// machine word (Myers' bit-parallel update). Otherwise only the diagonal band
+// |i - j| <= bound of the DP matrix is filled, one row of min(|a|, |b|) + 1 cells at a time.
+// Both stop as soon as the bound can no longer be met, and neither allocates for words
+// under 256 bytes.
+size_t boundedEditDistance(string_view a, string_view b, size_t bound);
+
+// Typos worth suggesting a correction for in a word of this length: about one per three
+// bytes, from 1 to 3 (a swapped pair of letters counts as 2).
+inline size_t suggestionRadius(size_t length) { return length < 6 ? 1 : length < 9 ? 2 : 3; }
+
+// Burkhard-Keller tree over words under edit distance, for "did you mean" suggestions.
+// Every child edge carries its distance to the parent word, so by the triangle inequality
+// a query within r of some word below an edge d only has to visit edges in
+// [dist(query, node) - r, dist(query, node) + r]. Nodes live in one vector and point at
+// their children by index.
+class BKTree {
+public:
+    struct Suggestion {
+        const string* word;
+        size_t distance;
+    };
+
+    // False if the word is already in the tree.
+    bool insert(const string& word);
+
+    // Up to `limit` words within maxDistance of query, closest first; equally close words
+    // come in insertion order. The search radius shrinks to the worst kept distance once
+    // `limit` words are found.
+    vector<Suggestion> closest(string_view query, size_t maxDistance, size_t limit = 1) const;
+
+    size_t size() const { return nodes.size(); }
+    void clear() { nodes.clear(); }
+
+private:
+    struct BKNode {
+        string word;
+        uint32_t maxEdge = 0;
+        vector<pair<uint32_t, uint32_t>> children;  // (distance, node index)
+    };
+    vector<BKNode> nodes;
+};
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef COMMANDREGISTRY_H
+#define COMMANDREGISTRY_H
+
+#include <string>
+#include <string_view>
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+using namespace std;
+
+// What a command accepts after its name. REQUIRED_ARGS commands called with nothing get
+// their usage line back instead of running; NO_ARGS commands ignore whatever follows.
+enum ArgSchema { NO_ARGS, OPTIONAL_ARGS, REQUIRED_ARGS };
+
+// One BhaiLang command: its name, argument schema, usage line ("banao <file>") and the
+// handler that gets the rest of the input line.
+struct CommandSpec {
+    string_view name;
+    ArgSchema args;
+    string_view usage;
+    string (*handler)(const string& arg);
+};
+
+// FNV-1a, seeded so that the registry can search for a seed without collisions.
+constexpr uint32_t commandHash(string_view name, uint32_t seed) {
+    uint32_t hash = 2166136261u ^ seed;
+    for (char c : name) hash = (hash ^ static_cast<unsigned char>(c)) * 16777619u;
+    return hash;
+}
+
+// Fixed set of commands with a perfect hash computed at compile time: the constructor
+// tries seeds until every name lands in its own slot of a SLOTS-entry table (SLOTS a power
+// of two), so find() is one hash, one table load and one name compare, with no heap
+// allocation. A set no seed separates fails to compile (the constructor reaches a throw).
+template <size_t N, size_t SLOTS>
+class CommandRegistry {
+    static_assert((SLOTS & (SLOTS - 1)) == 0 && SLOTS >= N, "SLOTS must be a power of two >= N");
+
+public:
+    constexpr explicit CommandRegistry(const array<CommandSpec, N>& specs) : specs(specs), slots{}, seed(0) {
+        for (uint32_t candidate = 1; candidate < 1u << 16; candidate++) {
+            for (auto& slot : slots) slot = -1;
+            bool collision = false;
+            for (size_t i = 0; i < N && !collision; i++) {
+                int16_t& slot = slots[commandHash(specs[i].name, candidate) & (SLOTS - 1)];
+                if (slot >= 0) collision = true;
+                else slot = static_cast<int16_t>(i);
+            }
+            if (!collision) {
+                seed = candidate;
+                return;
+            }
+        }
+        throw "no perfect hash seed for this command set";
+    }
+
+    // The command with this exact name, or nullptr.
+    constexpr const CommandSpec* find(string_view name) const {
+        int16_t slot = slots[commandHash(name, seed) & (SLOTS - 1)];
+        return slot >= 0 && specs[slot].name == name ? &specs[slot] : nullptr;
+    }
+
+    constexpr const CommandSpec* begin() const { return specs.data(); }
+    constexpr const CommandSpec* end() const { return specs.data() + N; }
+    constexpr size_t size() const { return N; }
+    constexpr uint32_t hashSeed() const { return seed; }
+    // Every spec has a name and a usage line, and no two share a name (checked with
+    // static_assert). Only the string_views are compared: handler addresses are not
+    // constant expressions under -fsanitize=undefined.
+    constexpr bool distinctNames() const {
+        for (size_t i = 0; i < N; i++) {
+            if (specs[i].name.empty() || specs[i].usage.empty()) return false;
+            for (size_t j = 0; j < i; j++)
+                if (specs[j].name == specs[i].name) return false;
+        }
+        return true;
+    }
+
+private:
+    array<CommandSpec, N> specs;
+    array<int16_t, SLOTS> slots;  // index into specs, -1 for an empty slot
+    uint32_t seed;
+};
+
+// Builds a registry from a braced list of specs, so the command count N is deduced rather
+// than written by hand: makeCommandRegistry<64>({{"banao", ...}, ...}).
+template <size_t SLOTS, size_t N>
+constexpr CommandRegistry<N, SLOTS> makeCommandRegistry(const CommandSpec (&list)[N]) {
+    array<CommandSpec, N> specs{};
+    for (size_t i = 0; i < N; i++) specs[i] = list[i];
+    return CommandRegistry<N, SLOTS>(specs);
+}
+
+#endif
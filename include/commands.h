@@ -13,6 +13,7 @@ extern HashTable metadataTable;
 
  string parseBhaiLang(const  string& input);
  string trim(const  string& str);  
+ bool parseNumber(const string &digits, size_t &value);
  string getPrompt();
 
 #endif
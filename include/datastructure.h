@@ -3,23 +3,92 @@
 
 #include <string>
 #include <map>
+#include <set>
+#include <unordered_map>
+#include <vector>
+#include <mutex>
+#include <memory>
+#include <string_view>
+#include <cstdint>
+#include "bktree.h"
+#include "threadpool.h"
+#include "dirscanner.h"
+#include "stringpool.h"
+#include "treesnapshot.h"
 using namespace std;
+// Index of a node in DirectoryTree's arena. An id stays valid until its node is removed;
+// freed ids are reused.
+typedef uint32_t NodeId;
+const NodeId NO_NODE = UINT32_MAX;
+
+// 40 bytes per entry: the name lives in the tree's string pool and the children are a
+// range of the tree's child-slot array, sorted by name, so a lookup is a binary search.
 struct TreeNode {
-      string name;  
-    TreeNode* parent;  
-      map<  string, TreeNode*> children;  
+    int64_t modified;     // a listed directory's mtime (ns) at listing, 0 if not to be trusted
+    uint32_t name;        // StringPool id
+    NodeId parent;        // NO_NODE for the root and for free slots
+    uint32_t firstChild;  // children: childSlots[firstChild, firstChild + childCount)
+    uint32_t childCount;
+    // Every other node with the same name (a doubly linked chain per name, see khojo).
+    NodeId previousSameName;
+    NodeId nextSameName;
+    int32_t watch;        // inotify watch descriptor of an expanded directory, -1 if none
+    // Directories start as stubs (expanded == false, no children) and are listed on first
+    // use; files never have children.
+    bool isDirectory;
+    bool expanded;
+    bool cycle;  // a symlink back to an ancestor, kept listed and empty
+};
 
-    
-    TreeNode(const   string& name, TreeNode* parent = nullptr) : name(name), parent(parent) {}
+// Children of one node, in name order. Invalidated by any change to the tree.
+struct ChildRange {
+    const NodeId* first;
+    const NodeId* last;
+    const NodeId* begin() const { return first; }
+    const NodeId* end() const { return last; }
+    size_t size() const { return last - first; }
+    bool empty() const { return first == last; }
+};
+
+// One entry of a directory listing.
+struct DirEntry {
+    string name;
+    bool isDirectory;
+};
+
+struct DirListing {
+    int64_t modified = 0;  // the directory's mtime (ns), read before its entries
+    int64_t listed = 0;    // when the entries were read (ns)
+    vector<DirEntry> entries;
+};
+
+
+// Matches per page of khojo output.
+const size_t KHOJO_PAGE_SIZE = 20;
+
+// What a node and everything below it take on disk, counted as du does: allocated blocks,
+// a hard-linked file at each of its names, a symlink as itself (never followed).
+struct DiskUsage {
+    uint64_t bytes = 0;
+    uint64_t files = 0;  // everything but directories
+    bool known = false;  // measured, and so is every node below it (unless it is a link)
+    bool link = false;   // a symlink: nothing below it counts towards it
 };
 
+// Entries listed by jagah unless asked for more or fewer.
+const size_t JAGAH_TOP = 10;
 
 class DirectoryTree {
 public:
-    TreeNode* root;  
-    TreeNode* current;  
+    NodeId root;  
+    NodeId current;  
       string currentPath;  
+      string rootPath;  // directory the root node stands for (the startup cwd)
     DirectoryTree();
+    // A tree over another directory. A persistent tree (the shell's) watches for changes
+    // with inotify and keeps a snapshot (treesnapshot.h) between sessions; others are for
+    // one-off walks such as benchmarks.
+    DirectoryTree(const   string& rootPath, bool persistent);
 
     
       string jaha();  
@@ -27,16 +96,174 @@ public:
       string wapas();  
       string dikhao();  
       string banaoDir(const   string& dirName); 
-      string khojo(const   string& fileName); 
+      // Every node in the tree named `pattern`, or matching it as a shell glob (* ? [...],
+      // e.g. "*.log"), as sorted paths, KHOJO_PAGE_SIZE per page. Answered from the name
+      // index; the first search expands the whole tree to fill it.
+      string khojo(const   string& pattern, size_t page = 1);
+      // Expanded nodes named exactly `name`: one hash lookup and a walk along its chain.
+      vector<NodeId> findByName(string_view name) const;
+      // Expanded nodes whose name matches a glob. Only names sharing the literal prefix
+      // before the first wildcard are tried, found by binary search in the sorted names.
+      vector<NodeId> findMatching(const   string& glob);
       string getCurrentPath(); 
+      // Disk usage of current/dirName (current itself if dirName is empty) and its `top`
+      // largest entries. The first call stats the whole subtree in parallel; the totals are
+      // kept per node from then on and follow banao/mitao/banaoDir and inotify, so a later
+      // call only measures what it cannot account for.
+      string jagah(const   string& dirName, size_t top = JAGAH_TOP);
+      // Lists node's directory into the tree if it is still a stub (no-op otherwise).
+      void expand(NodeId node);
+      // Expands every stub at or below node. Directories the snapshot knows and whose mtime
+      // is unchanged are taken from it (one stat each, in parallel); the rest are read in
+      // one parallel scan (see dirscanner.h). Directories that would close a symlink cycle
+      // are left expanded and empty.
+      void expandSubtree(NodeId node, const string& path);
+      // Writes the listed part of the tree, plus whatever the previous snapshot knew below
+      // directories not listed this session, to treeSnapshotPath(rootPath). Done on exit
+      // when the tree changed.
+      bool saveSnapshot();
+      // Filesystem path of a node.
+      string pathOf(NodeId node);
+      size_t expandedCount() const { return expansions; }
+
+      const TreeNode& node(NodeId id) const { return nodes[id]; }
+      // Valid until the next change to the tree.
+      string_view nameOf(NodeId id) const { return names.view(nodes[id].name); }
+      ChildRange children(NodeId id) const {
+          const NodeId* first = childSlots.data() + nodes[id].firstChild;
+          return {first, first + nodes[id].childCount};
+      }
+      // The child of dir with this name, or NO_NODE.
+      NodeId findChild(NodeId dir, string_view name) const;
+      size_t nodeCount() const { return nodes.size() - freeNodes.size(); }
+      // Bytes held by the arena, the child slots and the name pool.
+      size_t memoryUsage() const;
+      // Paths (relative to the current directory, starting with dirName) of every
+      // node below current/dirName that has no children. dirName may be nested ("a/b");
+      // empty if it is unknown or climbs out with "..".
+      // Both walks first expand the whole subtree with expandSubtree.
+      vector<string> subtreePaths(const   string& dirName);
+      // Paths (relative to the current directory) of every node below it with no children;
+      // files are always leaves, directories only when empty.
+      vector<string> leafPaths();
+      // Closest node name anywhere in the tree, a few typos at most away from `name`;
+      // empty if nothing is that close. The BK-tree behind it is built on first use from
+      // the directories expanded so far and grows as more are expanded; names that are gone
+      // are left in it and skipped.
+      string suggestName(const   string& name);
+
+      // Expanded directories are watched with inotify. syncChanges() applies what has
+      // happened since the last call (creates, deletes, renames) to the tree and is run
+      // before every command. If the event queue overflowed, the expanded part of the tree
+      // is re-listed; directories that got no watch (the watch limit was hit) are re-listed
+      // on their own whenever they are used.
+      void syncChanges();
+      // Changes BroBash makes itself (banao, mitao), applied right away instead of at the
+      // next sync. Paths are absolute or relative to the process cwd, which is rootPath.
+      void noteCreated(const   string& path, bool isDirectory);
+      void noteRemoved(const   string& path);
 
    
     ~DirectoryTree();
 
 private:
     
-    void deleteTree(TreeNode* node);  
-    void populateTree(TreeNode* node, const   string& path);  
+    // Arena bookkeeping. A directory whose child range has to grow is moved to the end of
+    // childSlots, leaving a hole; once holes make up half the array it is compacted.
+    NodeId newNode(string_view name, NodeId parent, bool isDirectory);
+    // Gives a fresh (childless) directory its children, sorted by name here.
+    void setChildren(NodeId dir, vector<NodeId>& ids);
+    void linkChild(NodeId dir, NodeId child);
+    void unlinkChild(NodeId dir, NodeId child);
+    void compactSlots();
+    void freeSubtree(NodeId node);
+    // Marks a stub as listed; false if it already was.
+    bool markExpanded(NodeId node);
+    // Name index upkeep: every node but the root is on its name's chain.
+    void indexNode(NodeId node);
+    void unindexNode(NodeId node);
+    // Merges names interned since the last glob query into sortedNames.
+    void sortNewNames();
+    bool isAncestor(NodeId ancestor, NodeId node) const;
+
+    void expand(NodeId node, const string& path);
+    // Hangs a scanned listing (and everything scanned below it) under a stub; `listed` is
+    // when the scan started.
+    void adopt(NodeId node, ScannedEntry& scanned, const string& path, int64_t listed);
+    // Fills stubs from the snapshot where it is still current; stubs and roots are left
+    // with what has to be scanned.
+    void importSnapshot(vector<NodeId>& stubs, vector<string>& roots);
+    // The snapshot's record for a node, or TreeSnapshot::NONE.
+    uint32_t snapshotNodeOf(NodeId node) const;
+    // Reads a directory's entries; symlinks count as directories when they point at one.
+    static bool listDirectory(const string& path, DirListing& listing);
+    // Lists the subdirectories of node in the background so entering them is instant.
+    void prefetchChildren(NodeId node, const string& path);
+    void collectLeafPaths(NodeId node, const string& path, vector<string>& paths);
+    void indexNames(NodeId node);
+
+    // inotify bookkeeping. One directory reached through two paths (a symlink) shares one
+    // watch descriptor between its nodes.
+    void watch(NodeId node, const string& path);
+    void unwatch(NodeId node);  // the whole subtree
+    // Re-lists an expanded directory and brings its children in line; `recursive` does the
+    // same for every expanded directory below it.
+    void resync(NodeId node, const string& path, bool recursive);
+    void refreshIfUnwatched(NodeId node, const string& path);
+    // The same for every unwatched directory in top's subtree; true if there were any
+    // (new subdirectories they turn up are still stubs).
+    bool refreshUnwatchedBelow(NodeId top);
+    // `isNew`: made just now (by us), so a directory starts listed and empty.
+    NodeId addChild(NodeId parent, const string& name, bool isDirectory, bool isNew = false);
+    void removeNode(NodeId node);
+    // Unhooks a subtree from its parent, moving current out of it if needed.
+    void detach(NodeId node);
+    // Node of the directory holding `path`, with the last component in `name`; NO_NODE if
+    // that directory is outside the tree or not expanded.
+    NodeId parentOf(const string& path, string& name);
+
+    // Fills in usage for everything below node that is not known yet (node itself too, and
+    // below it even if it is a link); returns how many entries had to be stat'ed.
+    size_t measureUsage(NodeId node, const string& path);
+    // Usage upkeep, from linkChild/unlinkChild and inotify: the counts of a child that comes
+    // or goes are added to or taken from every known directory above it. A child that
+    // cannot be measured on its own (a subtree moved in from outside) makes them unknown.
+    void usageLinked(NodeId dir, NodeId child);
+    void usageUnlinked(NodeId dir, NodeId child);
+    void usageChanged(NodeId file);
+    void forgetUsage(NodeId node);
+
+    vector<TreeNode> nodes;
+    vector<NodeId> childSlots;
+    vector<NodeId> freeNodes;
+    size_t deadSlots = 0;
+    size_t stubs = 0;  // directories not listed yet; 0 means the whole tree is in memory
+    StringPool names;
+    vector<NodeId> firstWithName;   // by name id: head of the chain, NO_NODE if none
+    vector<uint32_t> sortedNames;   // name ids in name order; newer ids not merged yet
+    vector<DiskUsage> usage;        // by NodeId; empty until the first jagah
+
+    bool persistent = false;
+    unique_ptr<TreeSnapshot> snapshot;
+    string snapshotPath;  // empty: no cache directory, nothing is saved
+    bool snapshotDirty = false;  // something was listed or changed since the snapshot
+
+    int inotifyFd = -1;
+    unordered_map<int, vector<NodeId>> watched;
+    set<NodeId> unwatched;
+
+    BKTree nameIndex;
+    bool nameIndexBuilt = false;
+    size_t expansions = 0;
+
+    // Listings made by the prefetch worker, by path, waiting for expand() to adopt them.
+    // Only the worker and expand() touch it, under prefetchLock; the tree itself is only
+    // ever changed on the calling thread. A new prefetch round bumps the generation and
+    // drops the previous round's unused listings.
+    mutex prefetchLock;
+    map<string, DirListing> prefetched;
+    size_t prefetchGeneration = 0;
+    unique_ptr<ThreadPool> prefetcher;
 };
 
 #endif
@@ -0,0 +1,48 @@
+#ifndef DIRSCANNER_H
+#define DIRSCANNER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+using namespace std;
+
+// Parallel full-tree directory scanner, used when a command needs a whole subtree at once
+// (dhoondo -r, suchi, baandho). Every directory is one task on a work-stealing pool; it is
+// opened with openat() relative to its parent's fd (no path strings are built), read with
+// getdents64() in SCAN_BUFFER_SIZE batches, and typed from d_type, so only symlinks and
+// filesystems that report DT_UNKNOWN cost a stat. Symlinks to directories are followed,
+// except into a directory that is already on the path from the scan root (same device and
+// inode), which would loop forever.
+const size_t SCAN_BUFFER_SIZE = 1 << 16;
+
+struct ScannedDirectory;
+
+struct ScannedEntry {
+    string name;
+    bool isDirectory = false;
+    bool cycle = false;                     // a directory that leads back to one of its ancestors
+    int64_t modified = 0;                   // a directory's mtime (ns), read before its entries
+    unique_ptr<ScannedDirectory> contents;  // directories that could be opened and are no cycle
+};
+
+struct ScannedDirectory {
+    vector<ScannedEntry> entries;  // in getdents order
+};
+
+struct ScanStats {
+    size_t directories = 0;
+    size_t entries = 0;
+    size_t statCalls = 0;  // entries d_type could not classify
+    size_t batches = 0;    // getdents64 calls
+    size_t cycles = 0;
+    size_t unreadable = 0;
+};
+
+// Scans each root directory and everything below it on `threads` workers. result[i] is
+// roots[i] (name = the path given), without contents if it cannot be opened.
+vector<ScannedEntry> scanDirectories(const vector<string>& roots, size_t threads, ScanStats& stats);
+
+#endif
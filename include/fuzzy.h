@@ -0,0 +1,46 @@
+#ifndef FUZZY_H
+#define FUZZY_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+using namespace std;
+
+// Approximate search for "dhoondo -k N": substrings within edit distance N (insertions,
+// deletions, substitutions) of the pattern. Like every dhoondo mode, a match never
+// crosses a newline.
+//
+// Myers' bit-parallel algorithm: a column of the edit-distance matrix is kept as vertical
+// +1/-1 delta bit vectors, 64 pattern bytes per word, and one text byte updates a word
+// with a handful of and/or/add operations. Longer patterns are split into 64-row blocks
+// chained by their horizontal carry, and only the blocks that can still lie within N
+// errors (Ukkonen's cutoff) are touched, so a byte costs O(N / 64 + 1) word operations
+// rather than the O(m) cells of the full matrix.
+class FuzzyMatcher {
+public:
+    // maxErrors must be less than the pattern length (checked by the caller).
+    FuzzyMatcher(const string& pattern, size_t maxErrors);
+
+    // First match ending after `from` that lies entirely in [from, size): [start, end)
+    // with its edit distance. Of the ends that match in a row, the first one with the
+    // lowest distance is taken, and start is the leftmost start reaching that distance.
+    // Scanning again from `end` gives non-overlapping matches. False when there is none.
+    bool nextMatch(const char* text, size_t size, size_t from, size_t& start, size_t& end, size_t& distance) const;
+
+    size_t blockCount() const { return blocks; }
+
+private:
+    string pattern;
+    size_t maxErrors;
+    size_t blocks;
+    vector<uint64_t> peq;  // 256 * blocks: bit i of word [c * blocks + b] = (pattern[64b + i] == c)
+    uint64_t lastHigh;     // the last block's bottom-row bit
+
+    // Leftmost start of an alignment of the pattern ending at `end` with `distance` errors,
+    // starting no earlier than lo.
+    size_t findStart(const unsigned char* text, size_t lo, size_t end, size_t distance) const;
+};
+
+#endif
@@ -5,9 +5,15 @@
 #include <vector>
 #include <list>
 #include <utility>
+#include <tuple>
+#include <cstdint>
 
 using namespace std;
 
+// Search result cache budget: 32 MB unless "dhoondo -m MB" sets it (0 turns caching off).
+const size_t PATTERN_CACHE_DEFAULT_BUDGET = 32 << 20;
+const size_t PATTERN_CACHE_MAX_BUDGET_MB = 4096;
+
 class HashTable {
 public:
    
@@ -17,7 +23,7 @@ public:
         string lastModified;
     };
 
-    HashTable(size_t size = 100);
+    HashTable(size_t size = 100, size_t cacheBudget = PATTERN_CACHE_DEFAULT_BUDGET);
     ~HashTable();
 
     
@@ -28,18 +34,58 @@ public:
     Metadata* getFileMetadata(const string& key);
     void removeFileMetadata(const string& key);
 
-    
+    // Search result cache. An entry is keyed by file name and pattern(s) and remembers the
+    // file's size and mtime at scan time; a lookup with a different stamp drops it. Once the
+    // cached results outgrow the byte budget the least recently used entries are evicted.
+    struct FileStamp {
+        uint64_t size = 0;
+        int64_t mtime = 0;  // nanoseconds
+        bool operator==(const FileStamp& other) const { return size == other.size && mtime == other.mtime; }
+    };
+    struct PatternResult {
+        vector<tuple<size_t, size_t, size_t>> occurrences;  // (line, position, pattern index)
+        vector<size_t> perPattern;
+        size_t matchedLines = 0;
+        size_t newlines = 0;
+        size_t lines = 0;  // newlines, plus one for an unterminated last line
+    };
+    static bool stampFile(const string& fileName, FileStamp& stamp);
+
+    // Several patterns searched together form one key: join them with '\0'.
+    // The returned pointer is valid until the next cache update.
+    const PatternResult* findPatternResult(const string& fileName, const string& pattern, const FileStamp& stamp);
+    void storePatternResult(const string& fileName, const string& pattern, const FileStamp& stamp,
+                            const PatternResult& result);
+    void setPatternCacheBudget(size_t bytes);
+    size_t patternCacheBudget() const { return cacheBudget; }
+    size_t patternCacheBytes() const { return cacheBytes; }
+    size_t patternCacheEntries() const { return lruKeys.size(); }
+    size_t patternCacheHits() const { return cacheHits; }
+    size_t patternCacheMisses() const { return cacheMisses; }
+    size_t patternCacheEvictions() const { return cacheEvictions; }
+
+    // Occurrences as (line, position) pairs, answered from the cache while the file is unchanged.
     vector<pair<int, int>> searchPattern(const string& fileName, const string& pattern);
-    vector<pair<int, int>>* getPatternOccurrences(const string& fileName, const string& pattern);
 
 private:
+    struct CacheEntry {
+        FileStamp stamp;
+        PatternResult result;
+        size_t bytes;
+        list<string>::iterator lru;
+    };
+
     vector<list<pair<string, int>>> commandTable;  
     vector<list<pair<string, Metadata>>> metadataTable;  
-    vector<list<pair<string, vector<pair<int, int>>>>> patternOccurrences;  
+    vector<list<pair<string, CacheEntry>>> patternCache;
+    list<string> lruKeys;  // most recently used first
     size_t tableSize;
+    size_t cacheBudget, cacheBytes;
+    size_t cacheHits, cacheMisses, cacheEvictions;
 
     
     size_t hashFunction(const string& key) const;
+    void erasePatternResult(const string& key);
 };
 
 #endif // HASHTABLE_H
@@ -4,13 +4,156 @@
 #include <string>
 #include <unordered_map>
 #include <queue>
+#include <cstdint>
 
 using namespace std;
 
+// Legacy text format: serialized code map, "\n====\n", then one '0'/'1' char per bit.
+// Still readable by padh, no longer written by likh.
 string decompressText(const std::string& binary, const std::unordered_map<char, std::string>& huffmanCode);
 unordered_map<char, std::string> buildHuffmanCode(const std::string& text);
 string compressText(const std::string& text);
 string serializeCodeMap(const std::unordered_map<char, std::string>& huffmanCode);
 unordered_map<char, std::string> deserializeCodeMap(const std::string& mapString);
 
+// Binary container written by likh:
+//   "BHUF" | version u8 | codec u8 | table size u16 | original length u64 |
+//   code lengths (4 bits per symbol, canonical Huffman) | bit-packed payload (MSB first)
+// All integers are little-endian.
+const uint8_t HUFFMAN_CONTAINER_VERSION = 1;
+const uint8_t HUFFMAN_CODEC_ORDER0 = 0;
+const uint8_t HUFFMAN_CODEC_LZ77 = 1;
+const int HUFFMAN_MAX_CODE_LENGTH = 12;
+const size_t HUFFMAN_HEADER_SIZE = 16;
+const int HUFFMAN_MAX_SYMBOLS = 512;
+
+void countBytes(const char* data, size_t size, uint64_t freq[256]);
+// Length-limited Huffman code lengths for symbolCount (<= HUFFMAN_MAX_SYMBOLS) symbols.
+// Works entirely in fixed-size stack arrays: no heap allocation.
+void buildCodeLengths(const uint64_t* freq, int symbolCount, uint8_t* lengths);
+void assignCanonicalCodes(const uint8_t* lengths, int symbolCount, uint32_t* codes);
+
+// MSB-first bit writer appending whole bytes to a string.
+class BitWriter {
+public:
+    explicit BitWriter(std::string& out) : out(out), buffer(0), bitCount(0) {}
+
+    // len <= 32 bits per call.
+    void write(uint32_t code, int len) {
+        buffer = (buffer << len) | code;
+        bitCount += len;
+        while (bitCount >= 8) {
+            bitCount -= 8;
+            out += static_cast<char>((buffer >> bitCount) & 0xFF);
+        }
+    }
+    // Pads the last partial byte with zero bits.
+    void flush() {
+        if (bitCount > 0) out += static_cast<char>((buffer << (8 - bitCount)) & 0xFF);
+        buffer = 0;
+        bitCount = 0;
+    }
+
+private:
+    std::string& out;
+    uint64_t buffer;
+    int bitCount;
+};
+
+// MSB-first bit reader over a byte buffer. Bits past the end read as zero; overrun()
+// reports whether more bits were consumed than the buffer holds.
+class BitReader {
+public:
+    BitReader(const unsigned char* data, size_t size)
+        : data(data), size(size), pos(0), buffer(0), bitCount(0), consumedBits(0), totalBits(size * 8) {}
+
+    // Tops the buffer up to at least 56 valid bits (while input lasts).
+    void refill() {
+        if (pos + 8 <= size) {
+            uint64_t word = 0;
+            for (int i = 0; i < 8; i++) word = (word << 8) | data[pos + i];
+            buffer |= word >> bitCount;
+            pos += (63 - bitCount) >> 3;
+            bitCount |= 56;
+            return;
+        }
+        while (bitCount <= 56) {
+            uint64_t byte = pos < size ? data[pos] : 0;
+            pos++;
+            buffer |= byte << (56 - bitCount);
+            bitCount += 8;
+        }
+    }
+    uint32_t peek(int n) const { return static_cast<uint32_t>(buffer >> (64 - n)); }
+    void consume(int n) { buffer <<= n; bitCount -= n; consumedBits += n; }
+    bool overrun() const { return consumedBits > totalBits; }
+    uint64_t bitsConsumed() const { return consumedBits; }
+    uint64_t bitsRemaining() const { return consumedBits < totalBits ? totalBits - consumedBits : 0; }
+
+private:
+    const unsigned char* data;
+    size_t size, pos;
+    uint64_t buffer;
+    int bitCount;
+    uint64_t consumedBits, totalBits;
+};
+
+// Canonical Huffman decoder with a single lookup table indexed by the next
+// maxLength bits; every table hit yields a whole symbol and its code length.
+class HuffmanDecoder {
+public:
+    // False if the lengths describe an over-subscribed code.
+    bool init(const uint8_t* lengths, int symbolCount);
+
+    // Caller must have refilled the reader with at least tableBits bits.
+    // Returns -1 for a bit pattern no code maps to.
+    int decode(BitReader& reader) const {
+        uint32_t entry = table[reader.peek(tableBits)];
+        reader.consume(entry & 0xFF);
+        return static_cast<int>(entry >> 8) - 1;
+    }
+    int maxLength() const { return tableBits; }
+
+private:
+    int tableBits = 1;
+    vector<uint32_t> table;  // (symbol + 1) << 8 | length; 0 marks an unused pattern
+};
+
+bool isHuffmanContainer(const std::string& data);
+string compressHuffman(const std::string& text);
+// Reads both container versions; version 2 blocks are decoded on `threads` workers.
+bool decompressHuffman(const std::string& data, std::string& output, size_t threads = 1);
+
+// Version 2 (block-split): the 16-byte header with a zero table size, then block size u32,
+// then blocks of: raw length u32 | encoded length u32 | codec-specific body. Each block has
+// its own tables, so blocks compress and decompress independently; the output depends only
+// on the block size and codec, never on the thread count. The header's codec byte selects
+// plain order-0 Huffman or LZ77 + Huffman for every block; only version 2 carries LZ77.
+const uint8_t HUFFMAN_BLOCKED_VERSION = 2;
+const size_t HUFFMAN_BLOCKED_HEADER_SIZE = 20;
+const size_t HUFFMAN_BLOCK_HEADER_SIZE = 8;
+const size_t HUFFMAN_DEFAULT_BLOCK_SIZE = 1 << 20;
+
+void compressHuffmanBlock(const char* data, size_t size, std::string& out, uint8_t codec = HUFFMAN_CODEC_ORDER0);
+bool decompressHuffmanBlock(const unsigned char* data, size_t size, char* out, uint64_t rawLength,
+                            uint8_t codec = HUFFMAN_CODEC_ORDER0);
+string compressHuffmanBlocks(const std::string& text, size_t blockSize, size_t threads,
+                             uint8_t codec = HUFFMAN_CODEC_ORDER0);
+bool decompressHuffmanBlocks(const std::string& data, std::string& output, size_t threads);
+uint8_t huffmanContainerCodec(const std::string& data);
+const char* huffmanCodecName(uint8_t codec);
+
+// Streaming file-to-file variants. compressHuffmanFile writes version 2 and keeps one input
+// and one output block per worker in memory; decompressHuffmanFile reads both versions
+// (version 1 through HUFFMAN_STREAM_CHUNK buffers). Peak memory does not grow with file size.
+// Both write a temporary beside the output and rename it into place on success, so the
+// output may be the input itself and a failed run leaves no partial output behind.
+const size_t HUFFMAN_STREAM_CHUNK = 1 << 20;
+bool compressHuffmanFile(const std::string& inputPath, const std::string& outputPath,
+                         uint64_t& originalBytes, uint64_t& compressedBytes,
+                         size_t threads = 1, size_t blockSize = HUFFMAN_DEFAULT_BLOCK_SIZE,
+                         uint8_t codec = HUFFMAN_CODEC_ORDER0);
+bool decompressHuffmanFile(const std::string& inputPath, const std::string& outputPath,
+                           uint64_t& originalBytes, uint64_t& compressedBytes, size_t threads = 1);
+
 #endif
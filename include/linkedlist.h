@@ -20,6 +20,8 @@ public:
        string getPreviousCommand();
        string getNextCommand();
        string itihas();
+    // Oldest command; follow next for the rest. Nodes live as long as the list.
+    const Node* first() const { return head; }
 
 private:
     Node* head;
@@ -0,0 +1,29 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <string>
+#include <cstddef>
+
+using namespace std;
+
+// Read-only memory mapping of a whole file. The pages are shared with the page cache,
+// so searching a multi-GB file costs no copies and no per-line buffers. Empty files
+// map to a zero-length buffer.
+class MappedFile {
+public:
+    explicit MappedFile(const string& path);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool isOpen() const { return opened; }
+    const char* data() const { return base; }
+    size_t size() const { return length; }
+
+private:
+    const char* base;
+    size_t length;
+    bool opened;
+};
+
+#endif
@@ -0,0 +1,124 @@
+#ifndef REGEXDFA_H
+#define REGEXDFA_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_set>
+#include <cstdint>
+#include <cstddef>
+
+using namespace std;
+
+// Regular expressions for "dhoondo -x", matched by lazily built DFAs (no backtracking).
+//
+// Syntax: literals, '.', classes "[a-z_]" / "[^0-9]", escapes \d \w \s \D \W \S and \<char>,
+// grouping "( )", alternation '|', and the repeats * + ? {m} {m,} {m,n}. '^' and '$' are
+// allowed only at the very start and end of the pattern and anchor to a line.
+// Nothing matches a newline, so every match lies within one line. Matches are reported
+// leftmost-longest and non-overlapping. Empty matches count too ("^$" finds empty lines,
+// "x?" matches every line); after one the caller moves on by a byte.
+//
+// RegexProgram is the compiled, immutable form (Thompson NFA plus byte classes) and can
+// be shared between threads; each thread scans with its own RegexSearcher, which owns
+// the DFA state caches.
+class RegexProgram {
+public:
+    // False, with a Hinglish message in `error`, when the pattern does not parse.
+    bool compile(const string& pattern, string& error);
+
+    // A string every match contains (possibly empty). The searcher jumps between its
+    // occurrences with searchFirst instead of running the DFA over every byte.
+    const string& requiredLiteral() const { return literal; }
+
+    // NFA node: BYTES consumes one byte of byteSets[byteSet] and moves to out, SPLIT moves
+    // to out and out1 without consuming, MATCH accepts.
+    enum Kind { BYTES, SPLIT, MATCH };
+    struct State {
+        Kind kind;
+        int byteSet;
+        int out, out1;
+    };
+
+private:
+    friend class RegexSearcher;
+
+    vector<State> states;
+    vector<State> reverseStates;  // the same pattern read right to left
+    vector<vector<uint64_t>> byteSets;  // 4 words (256 bits) each
+    int start = 0, reverseStart = 0;
+    bool anchorStart = false, anchorEnd = false;
+    uint8_t byteClass[256];
+    int classCount = 0;
+    string literal;
+};
+
+const size_t REGEX_DEFAULT_MAX_STATES = 4096;
+
+class RegexSearcher {
+public:
+    // Each DFA keeps at most maxStates states; when it fills up it is flushed and rebuilt
+    // on demand, so memory stays bounded whatever the pattern.
+    explicit RegexSearcher(const RegexProgram& program, size_t maxStates = REGEX_DEFAULT_MAX_STATES);
+
+    // First match starting at or after `from`: [start, end), possibly empty. False when
+    // there is none. Walking a line match by match is linear in its length (times the
+    // DFA states used): the floating DFA reads it once, the reverse DFA once to find where
+    // matches can start, and the anchored DFA runs from each match start only until it
+    // dies or reaches a (position, state) an earlier run on the line already went through.
+    bool nextMatch(const char* text, size_t size, size_t from, size_t& start, size_t& end);
+
+    size_t statesBuilt() const { return built; }
+    size_t cacheFlushes() const { return flushes; }
+    // Bytes fed to the anchored DFA so far (what the linear bound is about).
+    size_t anchoredSteps() const { return steps; }
+
+private:
+    // One lazily built DFA. State 0 is the start state; ids index `match` and rows of `next`.
+    struct Dfa {
+        bool floating;  // re-enters the NFA start after every byte (unanchored search)
+        bool reverse;   // runs the reversed NFA, fed the text right to left
+        map<vector<int>, int32_t> ids;
+        vector<vector<int>> sets;
+        vector<uint8_t> match;
+        vector<int32_t> next;  // sets.size() * classCount; -1 = not built yet
+    };
+
+    const RegexProgram& program;
+    size_t maxStates;
+    Dfa anchored, floating, reverse;
+    vector<int> startSet, reverseStartSet;
+    size_t built = 0, flushes = 0, steps = 0;
+
+    // Where matches can start in the line last searched: startable[p - startsBegin] for p
+    // in [startsBegin, startsEnd]. Reused while the caller continues from lastEnd.
+    vector<uint8_t> startable;
+    const unsigned char* startsText = nullptr;
+    size_t startsSize = 0, startsBegin = 0, startsEnd = 0, lastEnd = 0;
+    // (position << 32 | anchored state) pairs the anchored runs on that line went through,
+    // valid while no DFA has been flushed since visitedFlushes.
+    unordered_set<uint64_t> visited;
+    size_t visitedFlushes = 0;
+
+    // The caller is walking on from the last match, through the line startable covers.
+    bool continuesLine(const unsigned char* text, size_t size, size_t from) const {
+        return from > 0 && text == startsText && size == startsSize && from >= startsBegin &&
+               from <= startsEnd + 1 && (from == lastEnd || from == lastEnd + 1);
+    }
+    const vector<RegexProgram::State>& nfa(const Dfa& dfa) const {
+        return dfa.reverse ? program.reverseStates : program.states;
+    }
+    void addClosure(const Dfa& dfa, int state, vector<int>& set, vector<uint8_t>& seen) const;
+    void resetDfa(Dfa& dfa);
+    int32_t intern(Dfa& dfa, vector<int>& set);
+    int32_t step(Dfa& dfa, int32_t state, unsigned char byte);
+    bool isDead(const Dfa& dfa, int32_t state) const { return !dfa.floating && dfa.sets[state].empty(); }
+
+    // End of the longest match starting at begin, SIZE_MAX if none. With `shared`, the run
+    // stops where it meets an earlier run of this line (see matchInLine).
+    size_t longestFrom(const unsigned char* text, size_t begin, size_t lineEnd, bool shared = false);
+    // Leftmost-longest match starting in [from, lineEnd].
+    bool matchInLine(const unsigned char* text, size_t size, size_t from, size_t lineEnd, size_t& start, size_t& end);
+};
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+using namespace std;
+
+const size_t SEARCH_NPOS = static_cast<size_t>(-1);
+
+// Substring search kernel shared by dhoondo and HashTable::searchPattern.
+// Candidates are found by comparing the pattern's first and last bytes against a whole
+// vector of text positions at once (AVX2: 32, SSE2: 16), then verified with memcmp.
+// The widest instruction set the CPU supports is picked once at startup; other
+// architectures use a memchr-based scalar loop.
+//
+// Returns the offset of the first occurrence at or after `from`, or SEARCH_NPOS.
+size_t searchFirst(const char* text, size_t size, const char* pattern, size_t patternSize, size_t from = 0);
+
+// Offsets of every (possibly overlapping) occurrence.
+vector<size_t> searchAll(const char* text, size_t size, const string& pattern);
+
+// Number of bytes equal to `byte` (used to count newlines), vectorized like searchFirst.
+size_t countByte(const char* text, size_t size, char byte);
+
+// Content searches treat a file as binary (and skip it) when its first
+// BINARY_PROBE_BYTES contain a NUL byte.
+const size_t BINARY_PROBE_BYTES = 8192;
+bool looksBinary(const char* text, size_t size);
+
+// Maps non-decreasing offsets in a buffer to 1-based line numbers and 0-based columns.
+// Only the newlines between one query and the next are counted (with countByte), so a
+// scan that reports a few matches never touches lines it does not need.
+class LineLocator {
+public:
+    LineLocator(const char* text, size_t size) : text(text), size(size), line(1), lineStart(0), scanned(0) {}
+
+    void locate(size_t pos, size_t& lineNumber, size_t& column);
+    // Newlines in the whole buffer; counts the part after the last query on demand.
+    size_t totalNewlines();
+
+private:
+    const char* text;
+    size_t size, line, lineStart, scanned;
+};
+
+// "avx2", "sse2" or "scalar".
+const char* searchKernelName();
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef STRINGPOOL_H
+#define STRINGPOOL_H
+
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+using namespace std;
+
+// Interned strings in one growing character buffer, NUL-terminated and never freed. Equal
+// strings share one id and one copy (directory trees repeat names like "Makefile" or
+// "index.js" thousands of times). Ids are dense, 0, 1, 2, ... in first-intern order, so
+// per-string data can live in plain vectors indexed by id. Duplicates are found through
+// an open-addressing table of ids, 4 bytes per slot. Strings must not contain NUL bytes
+// (file names cannot).
+class StringPool {
+public:
+    static constexpr uint32_t NOT_FOUND = UINT32_MAX;
+
+    StringPool();
+
+    uint32_t intern(string_view text);
+    // The id of text if it has been interned, NOT_FOUND otherwise.
+    uint32_t find(string_view text) const;
+
+    // Valid until the next intern().
+    string_view view(uint32_t id) const {
+        return string_view(chars.data() + offsets[id], offsets[id + 1] - offsets[id] - 1);
+    }
+    const char* data(uint32_t id) const { return chars.data() + offsets[id]; }
+
+    // The whole buffer, every string followed by its NUL, and where string id starts in it:
+    // for writing a pool out in one piece.
+    string_view buffer() const { return string_view(chars.data(), chars.size()); }
+    uint32_t offset(uint32_t id) const { return offsets[id]; }
+
+    size_t size() const { return offsets.size() - 1; }
+    size_t memoryUsage() const { return chars.capacity() + (table.capacity() + offsets.capacity()) * sizeof(uint32_t); }
+
+private:
+    size_t slotOf(string_view text) const;
+    void rehash(size_t slots);
+
+    vector<char> chars;
+    vector<uint32_t> offsets;  // offsets[id] is where string id starts; one extra at the end
+    vector<uint32_t> table;    // ids, NOT_FOUND for a free slot; size is a power of two
+};
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Fixed-size work-stealing pool. Every worker owns a deque: tasks submitted from outside
+// are dealt round-robin across the deques, tasks submitted by a worker go on its own deque.
+// A worker takes its newest task first and, once its deque is empty, steals the oldest task
+// from another worker, so one slow task (a huge file, a big block) never strands the work
+// queued behind it. wait() blocks until every submitted task has finished.
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t threads);
+    ~ThreadPool();
+
+    void submit(function<void()> task);
+    void wait();
+    size_t size() const { return workers.size(); }
+
+    // Worker count to use when the user did not ask for one.
+    static size_t defaultThreads();
+    // Most workers a user-supplied -j N gets: four per core. More only costs stacks.
+    static size_t maxThreads();
+
+private:
+    struct WorkQueue {
+        mutex lock;
+        deque<function<void()>> tasks;
+    };
+
+    vector<thread> workers;
+    vector<unique_ptr<WorkQueue>> queues;
+    atomic<size_t> queued;    // tasks sitting in some deque
+    atomic<size_t> nextQueue; // round-robin cursor for outside submissions
+    mutex lock;               // guards pending/stopping and the sleep/wake handshake
+    condition_variable taskReady, allDone;
+    size_t pending;
+    bool stopping;
+
+    bool takeTask(size_t self, function<void()>& task);
+    void workerLoop(size_t self);
+};
+
+#endif
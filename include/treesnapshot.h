@@ -0,0 +1,91 @@
+#ifndef TREESNAPSHOT_H
+#define TREESNAPSHOT_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "mappedfile.h"
+#include "stringpool.h"
+
+using namespace std;
+
+// On-disk copy of the listed part of a DirectoryTree, so a new session can take unchanged
+// directories from it instead of reading them again.
+//
+// Snapshots are kept out of the tree, one per root, in $XDG_CACHE_HOME/brobash/ (or
+// ~/.cache/brobash/), named after a hash of the root path (see treeSnapshotPath).
+//
+// Layout, all integers little-endian:
+//   header: "BTRE" | version u32 | node count u32 | reserved u32 | names offset u64 |
+//           names size u64
+//   nodes:  per node: mtime ns i64 | name offset u32 | name length u16 | flags u16 |
+//           first child u32 | child count u32
+//   names:  the name bytes
+// Node 0 is the root. Nodes are in breadth-first order and a directory's children are one
+// run of nodes, sorted by name, after it. mtime is the directory's own mtime when it was
+// listed (0: unknown, always list again); a directory's entries can only have changed if
+// its mtime has. Every record is checked when it is read, so the file is mapped and used
+// in place without a pass over it.
+const uint32_t TREE_SNAPSHOT_VERSION = 1;
+const size_t TREE_SNAPSHOT_HEADER_SIZE = 32;
+const size_t TREE_SNAPSHOT_NODE_SIZE = 24;
+const uint16_t SNAPSHOT_DIRECTORY = 1;
+const uint16_t SNAPSHOT_LISTED = 2;  // a directory whose children are recorded
+const uint16_t SNAPSHOT_CYCLE = 4;   // a symlink back to an ancestor: listed as empty
+
+// One record to write; name is an id in the writer's StringPool.
+struct SnapshotNode {
+    int64_t modified;
+    uint32_t name;
+    uint16_t flags;
+    uint32_t firstChild;
+    uint32_t childCount;
+};
+
+// Where the snapshot of the tree rooted at rootPath lives; creates the cache directory if
+// needed. Empty if there is no cache directory to use (then nothing is saved or read).
+string treeSnapshotPath(const string& rootPath);
+
+// Writes the records to path (through a temporary file renamed over it).
+bool writeTreeSnapshot(const string& path, const vector<SnapshotNode>& nodes, const StringPool& names);
+
+// Read-only view of a snapshot file, mapped in place.
+class TreeSnapshot {
+public:
+    static const uint32_t ROOT = 0;
+    static const uint32_t NONE = UINT32_MAX;
+
+    explicit TreeSnapshot(const string& path);
+
+    bool isOpen() const { return valid; }
+    size_t size() const { return count; }
+
+    string_view name(uint32_t node) const;
+    uint16_t flags(uint32_t node) const { return static_cast<uint16_t>(getLE(record(node) + 14, 2)); }
+    int64_t modified(uint32_t node) const { return static_cast<int64_t>(getLE(record(node), 8)); }
+    // Children as [first, first + count); an empty range if the record is damaged.
+    uint32_t firstChild(uint32_t node) const { return static_cast<uint32_t>(getLE(record(node) + 16, 4)); }
+    uint32_t childCount(uint32_t node) const;
+    // The child of dir with this name (binary search), or NONE.
+    uint32_t findChild(uint32_t dir, string_view childName) const;
+
+private:
+    MappedFile file;
+    const unsigned char* base;
+    size_t count;
+    uint64_t namesOffset, namesSize;
+    bool valid;
+
+    const unsigned char* record(uint32_t node) const {
+        return base + TREE_SNAPSHOT_HEADER_SIZE + static_cast<size_t>(node) * TREE_SNAPSHOT_NODE_SIZE;
+    }
+    static uint64_t getLE(const unsigned char* in, int bytes) {
+        uint64_t value = 0;
+        for (int i = bytes - 1; i >= 0; i--) value = (value << 8) | in[i];
+        return value;
+    }
+};
+
+#endif
@@ -0,0 +1,89 @@
+#ifndef TRIGRAMINDEX_H
+#define TRIGRAMINDEX_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "mappedfile.h"
+
+using namespace std;
+
+// Trigram inverted index ("suchi") over the files under one directory, used by
+// "dhoondo -r" to shortlist the files that can contain a pattern before searching them.
+// A file can only contain a pattern if it contains every 3-byte substring of it.
+//
+// On-disk layout (TRIGRAM_INDEX_FILE in the indexed directory), all integers little-endian:
+//   header:   "BTRI" | version u32 | file count u32 | trigram count u32 |
+//             paths offset u64 | postings offset u64
+//   files:    per file, sorted by path: mtime ns i64 | size u64 | path offset u32 |
+//             path length u32 | flags u32 | reserved u32
+//   trigrams: per trigram, ascending: trigram u32 (bytes b0 << 16 | b1 << 8 | b2) |
+//             file count u32 | posting offset u64 (from the postings section)
+//   paths:    the path bytes, back to back
+//   postings: per trigram, ascending file ids as LEB128 varints of the gap to the previous id
+// Every section has a fixed place, so a reader maps the file and looks postings up in place.
+const char* const TRIGRAM_INDEX_FILE = ".brobash.tri";
+const uint32_t TRIGRAM_INDEX_VERSION = 1;
+const size_t TRIGRAM_HEADER_SIZE = 32;
+const size_t TRIGRAM_FILE_ENTRY_SIZE = 32;
+const size_t TRIGRAM_ENTRY_SIZE = 16;
+const uint32_t TRIGRAM_FILE_BINARY = 1;  // not indexed: looksBinary() said so
+
+struct TrigramIndexStats {
+    size_t files = 0;     // files in the new index
+    size_t reused = 0;    // unchanged since the last index; postings copied over
+    size_t scanned = 0;   // new or changed files read from disk
+    size_t binaries = 0;
+    size_t trigrams = 0;
+    uint64_t bytesScanned = 0;
+    uint64_t indexBytes = 0;
+};
+
+// Builds the index for baseDir/<path> (paths relative to baseDir) and writes it to
+// indexPath. When indexPath already holds an index, files whose size and mtime are
+// unchanged keep their postings and are not read again; if the old index turns out to be
+// damaged, every file is read again and a fresh index replaces it. Unreadable paths are
+// left out.
+bool updateTrigramIndex(const string& baseDir, const vector<string>& paths, const string& indexPath,
+                        size_t threads, TrigramIndexStats& stats);
+
+// Read-only view of an index file, mapped in place.
+class TrigramIndex {
+public:
+    explicit TrigramIndex(const string& indexPath);
+
+    bool isOpen() const { return valid; }
+    size_t fileCount() const { return files; }
+    size_t trigramCount() const { return trigrams; }
+
+    // File id of a path, or -1 when it is not indexed.
+    int64_t find(const string& path) const;
+    // Id of the path if it is indexed and fullPath still has the indexed size and mtime;
+    // -1 when the index cannot vouch for the file's current content.
+    int64_t currentId(const string& path, const string& fullPath) const;
+    bool isBinary(size_t id) const;
+
+    // Sets candidate[id] = 1 for every file that contains all trigrams of the pattern.
+    // Patterns shorter than 3 bytes carry no trigram and mark every file, and so does a
+    // posting list that fails to decode: a damaged index never hides a match.
+    void markCandidates(const string& pattern, vector<uint8_t>& candidate) const;
+    // The n-th trigram of the table (n < trigramCount()) and its file ids, appended to ids.
+    // False if the posting list runs off the end of the file.
+    bool postings(size_t n, uint32_t& trigram, vector<uint32_t>& ids) const;
+
+private:
+    MappedFile file;
+    const unsigned char* base;
+    size_t files, trigrams;
+    uint64_t pathsOffset, postingsOffset;
+    bool valid;
+
+    const unsigned char* fileEntry(size_t id) const { return base + TRIGRAM_HEADER_SIZE + id * TRIGRAM_FILE_ENTRY_SIZE; }
+    const unsigned char* trigramEntry(size_t index) const;
+    // Table entry of the trigram, or nullptr when no file contains it.
+    const unsigned char* findTrigram(uint32_t trigram) const;
+    bool decodePostings(const unsigned char* entry, vector<uint32_t>& ids) const;
+};
+
+#endif
@@ -0,0 +1,66 @@
+#include "ahocorasick.h"
+#include <queue>
+
+using namespace std;
+
+AhoCorasick::AhoCorasick(const vector<string>& patterns) {
+    // Byte classes: one per distinct byte used by the patterns, plus class 0 for the rest.
+    fill(byteClass, byteClass + 256, 0);
+    classCount = 1;
+    for (const string& pattern : patterns)
+        for (unsigned char c : pattern)
+            if (byteClass[c] == 0) byteClass[c] = static_cast<uint8_t>(classCount++);
+
+    // Trie, built directly into the dense table (-1 = no edge yet).
+    next.assign(classCount, -1);
+    outputPattern.assign(1, -1);
+    for (size_t index = 0; index < patterns.size(); index++) {
+        if (patterns[index].empty()) continue;
+        int32_t state = 0;
+        for (unsigned char c : patterns[index]) {
+            size_t slot = static_cast<size_t>(state) * classCount + byteClass[c];
+            if (next[slot] < 0) {
+                next[slot] = static_cast<int32_t>(outputPattern.size());
+                outputPattern.push_back(-1);
+                next.resize(next.size() + classCount, -1);
+            }
+            state = next[slot];
+        }
+        if (outputPattern[state] < 0) outputPattern[state] = static_cast<int32_t>(index);
+    }
+
+    // Breadth-first pass: missing edges borrow the failure state's transition, which
+    // turns the trie into a complete DFA; output links follow the failure chain.
+    size_t states = outputPattern.size();
+    vector<int32_t> fail(states, 0);
+    outputLink.assign(states, -1);
+    queue<int32_t> pending;
+    for (size_t c = 0; c < classCount; c++) {
+        int32_t& target = next[c];
+        if (target < 0) {
+            target = 0;
+        } else {
+            fail[target] = 0;
+            pending.push(target);
+        }
+    }
+    while (!pending.empty()) {
+        int32_t state = pending.front();
+        pending.pop();
+        int32_t f = fail[state];
+        outputLink[state] = outputPattern[f] >= 0 ? f : outputLink[f];
+        for (size_t c = 0; c < classCount; c++) {
+            int32_t& target = next[static_cast<size_t>(state) * classCount + c];
+            int32_t fallback = next[static_cast<size_t>(f) * classCount + c];
+            if (target < 0) {
+                target = fallback;
+            } else {
+                fail[target] = fallback;
+                pending.push(target);
+            }
+        }
+    }
+
+    hasOutput.resize(states);
+    for (size_t s = 0; s < states; s++) hasOutput[s] = outputPattern[s] >= 0 || outputLink[s] >= 0;
+}
@@ -0,0 +1,154 @@
+#include "archive.h"
+#include "huffman.h"
+#include "threadpool.h"
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+
+using namespace std;
+
+static void putLE(string& out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) out += static_cast<char>((value >> (8 * i)) & 0xFF);
+}
+
+static uint64_t getLE(const string& in, size_t pos, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++)
+        value |= static_cast<uint64_t>(static_cast<unsigned char>(in[pos + i])) << (8 * i);
+    return value;
+}
+
+bool isSafeMemberPath(const string& path) {
+    if (path.empty() || path[0] == '/') return false;
+    for (size_t start = 0; start <= path.size();) {
+        size_t slash = path.find('/', start);
+        if (slash == string::npos) slash = path.size();
+        if (path.compare(start, slash - start, "..") == 0) return false;
+        start = slash + 1;
+    }
+    return true;
+}
+
+bool writeArchive(const string& archivePath, const string& baseDir, const vector<string>& paths,
+                  size_t threads, uint8_t codec, vector<ArchiveMember>& written, vector<string>& skipped) {
+    ofstream out(archivePath, ios::binary);
+    if (!out) return false;
+    threads = max<size_t>(min({threads, ThreadPool::maxThreads(), paths.size()}), 1);
+
+    string header = "BBAR";
+    header += static_cast<char>(1);
+    header.append(3, '\0');
+    out.write(header.data(), header.size());
+    uint64_t offset = header.size();
+
+    // Members are compressed a batch at a time (two per worker) and written in order,
+    // so memory holds one batch rather than the whole tree.
+    ThreadPool pool(threads);
+    const size_t batchSize = threads * 2;
+    vector<string> compressed(batchSize);
+    vector<uint64_t> originalSizes(batchSize);
+    vector<char> readable(batchSize);
+    for (size_t first = 0; first < paths.size(); first += batchSize) {
+        size_t count = min(batchSize, paths.size() - first);
+        for (size_t i = 0; i < count; i++)
+            pool.submit([&, i] {
+                readable[i] = false;
+                if (!isSafeMemberPath(paths[first + i])) return;
+                ifstream file(baseDir + "/" + paths[first + i], ios::binary);
+                readable[i] = static_cast<bool>(file);
+                if (!file) return;
+                string content((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+                originalSizes[i] = content.size();
+                compressed[i] = compressHuffmanBlocks(content, HUFFMAN_DEFAULT_BLOCK_SIZE, 1, codec);
+            });
+        pool.wait();
+        for (size_t i = 0; i < count; i++) {
+            if (!readable[i]) {
+                skipped.push_back(paths[first + i]);
+                continue;
+            }
+            out.write(compressed[i].data(), compressed[i].size());
+            written.push_back({paths[first + i], offset, compressed[i].size(), originalSizes[i]});
+            offset += compressed[i].size();
+            string().swap(compressed[i]);
+        }
+    }
+
+    string index;
+    putLE(index, written.size(), 4);
+    for (const auto& member : written) {
+        putLE(index, member.path.size(), 2);
+        index += member.path;
+        putLE(index, member.offset, 8);
+        putLE(index, member.compressedSize, 8);
+        putLE(index, member.originalSize, 8);
+    }
+    putLE(index, offset, 8);
+    index += "BBIX";
+    out.write(index.data(), index.size());
+    return static_cast<bool>(out);
+}
+
+// Reads the footer and index; leaves `file` open for member reads.
+static bool loadIndex(ifstream& file, vector<ArchiveMember>& index) {
+    string header(ARCHIVE_HEADER_SIZE, '\0');
+    if (!file.read(&header[0], header.size()) || header.compare(0, 4, "BBAR") != 0) return false;
+
+    file.seekg(0, ios::end);
+    uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+    if (fileSize < ARCHIVE_HEADER_SIZE + ARCHIVE_FOOTER_SIZE + 4) return false;
+    string footer(ARCHIVE_FOOTER_SIZE, '\0');
+    file.seekg(fileSize - ARCHIVE_FOOTER_SIZE);
+    if (!file.read(&footer[0], footer.size()) || footer.compare(8, 4, "BBIX") != 0) return false;
+
+    uint64_t indexOffset = getLE(footer, 0, 8);
+    if (indexOffset < ARCHIVE_HEADER_SIZE || indexOffset > fileSize - ARCHIVE_FOOTER_SIZE) return false;
+    string raw(fileSize - ARCHIVE_FOOTER_SIZE - indexOffset, '\0');
+    file.seekg(indexOffset);
+    if (!file.read(&raw[0], raw.size()) || raw.size() < 4) return false;
+
+    uint64_t count = getLE(raw, 0, 4);
+    size_t pos = 4;
+    index.clear();
+    for (uint64_t i = 0; i < count; i++) {
+        if (raw.size() - pos < 2) return false;
+        size_t pathLength = getLE(raw, pos, 2);
+        if (raw.size() - pos < 2 + pathLength + 24) return false;
+        ArchiveMember member;
+        member.path = raw.substr(pos + 2, pathLength);
+        pos += 2 + pathLength;
+        member.offset = getLE(raw, pos, 8);
+        member.compressedSize = getLE(raw, pos + 8, 8);
+        member.originalSize = getLE(raw, pos + 16, 8);
+        pos += 24;
+        if (member.offset + member.compressedSize > indexOffset) return false;
+        index.push_back(member);
+    }
+    return true;
+}
+
+bool isArchive(const string& archivePath) {
+    ifstream file(archivePath, ios::binary);
+    char magic[4];
+    return file.read(magic, 4) && string(magic, 4) == "BBAR";
+}
+
+bool readArchiveIndex(const string& archivePath, vector<ArchiveMember>& index) {
+    ifstream file(archivePath, ios::binary);
+    return file && loadIndex(file, index);
+}
+
+bool readArchiveMember(const string& archivePath, const string& memberPath, string& content) {
+    ifstream file(archivePath, ios::binary);
+    vector<ArchiveMember> index;
+    if (!file || !loadIndex(file, index)) return false;
+
+    auto it = find_if(index.begin(), index.end(), [&](const ArchiveMember& m) { return m.path == memberPath; });
+    if (it == index.end()) return false;
+
+    string compressed(it->compressedSize, '\0');
+    file.clear();
+    file.seekg(it->offset);
+    if (!file.read(&compressed[0], compressed.size())) return false;
+    return decompressHuffman(compressed, content) && content.size() == it->originalSize;
+}
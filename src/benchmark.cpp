@@ -0,0 +1,430 @@
+#include "benchmark.h"
+#include "commands.h"
+#include "huffman.h"
+#include "search.h"
+#include "dirscanner.h"
+#include "threadpool.h"
+#include "datastructure.h"
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <iomanip>
+#include <queue>
+#include <random>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+#include <dirent.h>
+#include <malloc.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace std::chrono;
+
+// The counter of the innermost live AllocationCounter on this thread, if any.
+static thread_local size_t* countedAllocations = nullptr;
+
+bool AllocationCounter::enabled = false;
+
+void AllocationCounter::noteAllocation() {
+    if (countedAllocations) ++*countedAllocations;
+}
+
+AllocationCounter::AllocationCounter() : previous(countedAllocations) { countedAllocations = &count; }
+AllocationCounter::~AllocationCounter() { countedAllocations = previous; }
+
+// An allocation count for a report column: "n/a" where operator new is not counted.
+static string allocationText(size_t count) {
+    return AllocationCounter::enabled ? to_string(count) : "n/a";
+}
+
+namespace {
+
+// The pre-arena tree builder, kept as the baseline: unordered_map histogram, one `new`
+// per tree node, codes built by recursive string concatenation.
+struct LegacyNode {
+    char ch;
+    int freq;
+    LegacyNode *left, *right;
+    LegacyNode(char c, int f) : ch(c), freq(f), left(nullptr), right(nullptr) {}
+    LegacyNode(LegacyNode* l, LegacyNode* r) : ch('\0'), freq(l->freq + r->freq), left(l), right(r) {}
+};
+
+struct LegacyCompare {
+    bool operator()(LegacyNode* a, LegacyNode* b) { return a->freq > b->freq; }
+};
+
+void legacyCodeMap(LegacyNode* root, const string& str, unordered_map<char, string>& codeMap) {
+    if (!root) return;
+    if (!root->left && !root->right) codeMap[root->ch] = str;
+    legacyCodeMap(root->left, str + "0", codeMap);
+    legacyCodeMap(root->right, str + "1", codeMap);
+}
+
+void legacyFree(LegacyNode* root) {
+    if (!root) return;
+    legacyFree(root->left);
+    legacyFree(root->right);
+    delete root;
+}
+
+unordered_map<char, string> legacyHuffmanCode(const string& text) {
+    unordered_map<char, int> freq;
+    for (char c : text) freq[c]++;
+
+    priority_queue<LegacyNode*, vector<LegacyNode*>, LegacyCompare> pq;
+    for (auto& [ch, f] : freq) pq.push(new LegacyNode(ch, f));
+    while (pq.size() > 1) {
+        LegacyNode* left = pq.top(); pq.pop();
+        LegacyNode* right = pq.top(); pq.pop();
+        pq.push(new LegacyNode(left, right));
+    }
+    unordered_map<char, string> codeMap;
+    legacyCodeMap(pq.top(), "", codeMap);
+    legacyFree(pq.top());
+    return codeMap;
+}
+
+// Text with a skewed, log-like byte distribution.
+string sampleText(size_t size, unsigned seed) {
+    static const char alphabet[] = "etaoinshrdlucmfwypvbgkjqxz ETAOIN0123456789:/.-_[]=\n";
+    mt19937 rng(seed);
+    geometric_distribution<int> pick(0.12);
+    string text(size, ' ');
+    for (auto& c : text) c = alphabet[min<int>(pick(rng), sizeof(alphabet) - 2)];
+    return text;
+}
+
+struct Measurement {
+    double micros;
+    size_t allocations;
+};
+
+template <typename F>
+Measurement measure(F&& body, int repeats) {
+    AllocationCounter allocations;
+    auto start = steady_clock::now();
+    for (int r = 0; r < repeats; r++) body();
+    auto end = steady_clock::now();
+    return {duration_cast<nanoseconds>(end - start).count() / 1000.0 / repeats,
+            allocations.count / repeats};
+}
+
+string benchHuffman() {
+    stringstream ss;
+    ss << "Bhai! Huffman code banane ka benchmark (histogram + tree + codes):\n";
+    ss << left << setw(10) << "Input" << setw(18) << "Legacy allocs" << setw(16) << "Legacy μs"
+       << setw(16) << "Arena allocs" << setw(14) << "Arena μs" << "\n";
+    for (size_t size : {size_t(1) << 10, size_t(1) << 16, size_t(1) << 20, size_t(1) << 23}) {
+        string text = sampleText(size, 42);
+        int repeats = size <= (1 << 16) ? 50 : 3;
+        volatile size_t sink = 0;
+        Measurement legacy = measure([&] { sink += legacyHuffmanCode(text).size(); }, repeats);
+        Measurement arena = measure([&] {
+            uint64_t freq[256] = {0};
+            uint8_t lengths[256];
+            uint32_t codes[256];
+            countBytes(text.data(), text.size(), freq);
+            buildCodeLengths(freq, 256, lengths);
+            assignCanonicalCodes(lengths, 256, codes);
+            sink += codes[static_cast<unsigned char>(text[0])];
+        }, repeats);
+        ss << left << setw(10) << (to_string(size >> 10) + " KB") << setw(18) << allocationText(legacy.allocations)
+           << setw(16) << fixed << setprecision(1) << legacy.micros
+           << setw(16) << allocationText(arena.allocations) << setw(14) << arena.micros << "\n";
+    }
+    ss << (AllocationCounter::enabled ? "Arena allocations constant rehne chahiye (0), input size se farak nahi padta."
+                                      : "Allocations sirf BroBash-bench mein gine jaate hain (make bench).");
+    return ss.str();
+}
+
+// The bad-character-only Boyer-Moore that dhoondo used before the vectorized kernel.
+// Table lookups go through unsigned char here; the original indexed with a signed char,
+// which is out of bounds for bytes >= 0x80.
+vector<int> legacyBoyerMoore(const string& text, const string& pattern) {
+    int m = pattern.size(), n = text.size();
+    vector<int> badChar(256, -1);
+    for (int i = 0; i < m; i++) badChar[static_cast<unsigned char>(pattern[i])] = i;
+    vector<int> result;
+    int shift = 0;
+    while (shift <= (n - m)) {
+        int j = m - 1;
+        while (j >= 0 && pattern[j] == text[shift + j]) j--;
+        if (j < 0) {
+            result.push_back(shift);
+            shift += (shift + m < n) ? m - badChar[static_cast<unsigned char>(text[shift + m])] : 1;
+        } else {
+            shift += max(1, j - badChar[static_cast<unsigned char>(text[shift + j])]);
+        }
+    }
+    return result;
+}
+
+// The sample buffer is held in memory in one piece, so its size is capped.
+static const size_t BENCH_SEARCH_MAX_MB = 4096;
+
+// Throughput of legacy Boyer-Moore, std::string::find and the search kernel over one buffer.
+string benchSearch(const string& sizeArg) {
+    size_t megabytes = 64;
+    if (!sizeArg.empty() && (!parseNumber(sizeArg, megabytes) || megabytes < 1 || megabytes > BENCH_SEARCH_MAX_MB))
+        return "Bhai! Usage: naapo search [MB], MB 1 se " + to_string(BENCH_SEARCH_MAX_MB) + " tak.";
+    string text = sampleText(megabytes << 20, 11);
+    // Plant a known needle so every pattern has some hits.
+    for (size_t pos = 4096; pos + 64 < text.size(); pos += 1 << 20)
+        text.replace(pos, 40, "connection reset by peer while reading ");
+
+    stringstream ss;
+    ss << "Bhai! Search benchmark (" << megabytes << " MB, kernel: " << searchKernelName() << "):\n";
+    ss << left << setw(44) << "Pattern" << setw(10) << "Hits" << setw(16) << "BoyerMoore MB/s"
+       << setw(16) << "find MB/s" << "Kernel MB/s\n";
+    for (const string& pattern : {string("peer"), string("reset by"), string("connection reset by peer"),
+                                 string("connection reset by peer while reading ")}) {
+        vector<int> bm;
+        vector<size_t> kernel;
+        size_t findHits = 0;
+        auto t0 = steady_clock::now();
+        bm = legacyBoyerMoore(text, pattern);
+        auto t1 = steady_clock::now();
+        for (size_t pos = text.find(pattern); pos != string::npos; pos = text.find(pattern, pos + 1)) findHits++;
+        auto t2 = steady_clock::now();
+        kernel = searchAll(text.data(), text.size(), pattern);
+        auto t3 = steady_clock::now();
+
+        auto rate = [&](steady_clock::time_point a, steady_clock::time_point b) {
+            return megabytes / max(duration<double>(b - a).count(), 1e-9);
+        };
+        ss << left << setw(44) << ("'" + pattern + "'") << setw(10) << kernel.size() << fixed << setprecision(0)
+           << setw(16) << rate(t0, t1) << setw(16) << rate(t1, t2) << rate(t2, t3)
+           << (bm.size() == kernel.size() && findHits == kernel.size() ? "" : "  (hit count mismatch!)") << "\n";
+    }
+    return ss.str();
+}
+
+// Ratio and single-threaded MB/s of each container codec on one file (or sample text).
+string benchCodecs(const string& fileName) {
+    string text;
+    if (!fileName.empty()) {
+        ifstream file(fileName, ios::binary);
+        if (!file) return "Bhai! File '" + fileName + "' nahi mil rahi.";
+        text.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+    } else {
+        text = sampleText(size_t(1) << 22, 7);
+    }
+    if (text.empty()) return "Bhai! File khaali hai, naapne ko kuch nahi.";
+
+    stringstream ss;
+    ss << "Bhai! Codec comparison (" << text.size() << " bytes, 1 thread):\n";
+    ss << left << setw(18) << "Codec" << setw(12) << "Ratio" << setw(18) << "Compress MB/s" << "Decompress MB/s\n";
+    for (uint8_t codec : {HUFFMAN_CODEC_ORDER0, HUFFMAN_CODEC_LZ77}) {
+        string compressed, restored;
+        auto start = steady_clock::now();
+        compressed = compressHuffmanBlocks(text, HUFFMAN_DEFAULT_BLOCK_SIZE, 1, codec);
+        auto mid = steady_clock::now();
+        bool ok = decompressHuffman(compressed, restored, 1) && restored == text;
+        auto end = steady_clock::now();
+        double mb = text.size() / 1048576.0;
+        ss << left << setw(18) << huffmanCodecName(codec) << setw(12) << fixed << setprecision(2)
+           << (to_string(100.0 * compressed.size() / text.size()).substr(0, 5) + "%")
+           << setw(18) << mb / max(duration<double>(mid - start).count(), 1e-9)
+           << mb / max(duration<double>(end - mid).count(), 1e-9) << (ok ? "" : "  (round trip FAILED)") << "\n";
+    }
+    return ss.str();
+}
+
+// The walker the directory tree used to build itself with: opendir/readdir, a path string
+// per entry, and an opendir attempt on every entry, files included. The original also
+// followed symlinked directories and never returned from a symlink loop; here they are
+// skipped, so on trees with symlinks the legacy count is the lower one.
+void legacyWalk(const string& path, size_t& entries) {
+    DIR* dir = opendir(path.c_str());
+    if (dir == NULL) return;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (string(entry->d_name) == "." || string(entry->d_name) == "..") continue;
+        string childPath = path + "/" + entry->d_name;
+        entries++;
+        if (entry->d_type != DT_LNK) legacyWalk(childPath, entries);
+    }
+    closedir(dir);
+}
+
+// Full-tree scan of one directory: the legacy walker against the getdents64 scanner on one
+// thread and on every core.
+string benchScan(const string& dirArg) {
+    char cwd[PATH_MAX];
+    string root = !dirArg.empty() ? dirArg : getcwd(cwd, sizeof(cwd)) ? string(cwd) : ".";
+    ScanStats warmup;
+    if (scanDirectories({root}, 1, warmup)[0].contents == nullptr)
+        return "Bhai! Directory '" + root + "' khul nahi rahi.";
+
+    stringstream ss;
+    ss << "Bhai! Directory scan benchmark (" << root << ", " << warmup.entries << " entries, "
+       << warmup.directories << " directories, warm cache):\n";
+    ss << left << setw(28) << "Walker" << setw(12) << "Entries" << setw(12) << "Time ms" << setw(16) << "Entries/s"
+       << "stat / getdents / cycles\n";
+    auto row = [&](const string& name, size_t entries, steady_clock::time_point a, steady_clock::time_point b,
+                   const string& extra) {
+        double seconds = max(duration<double>(b - a).count(), 1e-9);
+        ss << left << setw(28) << name << setw(12) << entries << fixed << setprecision(1) << setw(12) << seconds * 1000
+           << setprecision(0) << setw(16) << entries / seconds << extra << "\n";
+    };
+
+    size_t legacyEntries = 0;
+    auto t0 = steady_clock::now();
+    legacyWalk(root, legacyEntries);
+    auto t1 = steady_clock::now();
+    row("opendir/readdir (legacy)", legacyEntries, t0, t1, "-");
+
+    vector<size_t> threadCounts = {1};
+    if (ThreadPool::defaultThreads() > 1) threadCounts.push_back(ThreadPool::defaultThreads());
+    for (size_t threads : threadCounts) {
+        ScanStats stats;
+        auto a = steady_clock::now();
+        scanDirectories({root}, threads, stats);
+        auto b = steady_clock::now();
+        row("getdents64 scan, " + to_string(threads) + " thread" + (threads == 1 ? "" : "s"), stats.entries, a, b,
+            to_string(stats.statCalls) + " / " + to_string(stats.batches) + " / " + to_string(stats.cycles));
+    }
+    return ss.str();
+}
+
+// The node the directory tree was made of before the arena: a heap string, a parent
+// pointer and a std::map of children per entry, torn down recursively.
+struct LegacyTreeNode {
+    string name;
+    LegacyTreeNode* parent;
+    map<string, LegacyTreeNode*> children;
+    bool isDirectory;
+    bool expanded;
+    LegacyTreeNode(const string& name, LegacyTreeNode* parent, bool isDirectory)
+        : name(name), parent(parent), isDirectory(isDirectory), expanded(!isDirectory) {}
+};
+
+void legacyAdopt(LegacyTreeNode* node, ScannedEntry& scanned) {
+    node->expanded = true;
+    if (!scanned.contents) return;
+    for (ScannedEntry& child : scanned.contents->entries) {
+        LegacyTreeNode* childNode = new LegacyTreeNode(child.name, node, child.isDirectory);
+        node->children[child.name] = childNode;
+        if (child.isDirectory) legacyAdopt(childNode, child);
+    }
+}
+
+void legacyDelete(LegacyTreeNode* node) {
+    for (auto& [name, child] : node->children) legacyDelete(child);
+    delete node;
+}
+
+size_t heapInUse() {
+    return mallinfo2().uordblks;
+}
+
+// The same fully expanded tree as map-of-strings nodes and as the arena: build (scan
+// included), heap held afterwards, a khojo-style walk comparing every name (best of 5)
+// and teardown.
+string benchTree(const string& dirArg) {
+    char cwd[PATH_MAX];
+    string root = !dirArg.empty() ? dirArg : getcwd(cwd, sizeof(cwd)) ? string(cwd) : ".";
+    ScanStats warmup;
+    if (scanDirectories({root}, ThreadPool::defaultThreads(), warmup)[0].contents == nullptr)
+        return "Bhai! Directory '" + root + "' khul nahi rahi.";
+    const string missing = "\x01no such name";
+
+    stringstream ss;
+    ss << "Bhai! Directory tree benchmark (" << root << ", " << warmup.entries << " entries):\n";
+    ss << left << setw(24) << "Layout" << setw(12) << "Build ms" << setw(12) << "Heap MB" << setw(10) << "B/entry"
+       << setw(14) << "Allocations" << setw(12) << "Walk ms" << "Teardown ms\n";
+    auto row = [&](const string& name, double build, size_t heap, size_t allocs, double walk, double teardown) {
+        ss << left << setw(24) << name << fixed << setprecision(1) << setw(12) << build * 1000 << setprecision(2)
+           << setw(12) << heap / 1048576.0 << setprecision(0) << setw(10) << double(heap) / max<size_t>(1, warmup.entries)
+           << setw(14) << allocationText(allocs) << setprecision(2) << setw(12) << walk * 1000 << teardown * 1000 << "\n";
+    };
+    auto seconds = [](steady_clock::time_point a, steady_clock::time_point b) { return duration<double>(b - a).count(); };
+    volatile size_t sink = 0;
+
+    {
+        size_t heapBefore = heapInUse();
+        unique_ptr<AllocationCounter> allocations(new AllocationCounter());
+        auto t0 = steady_clock::now();
+        LegacyTreeNode* tree = new LegacyTreeNode("/", nullptr, true);
+        {
+            ScanStats stats;
+            vector<ScannedEntry> scanned = scanDirectories({root}, ThreadPool::defaultThreads(), stats);
+            legacyAdopt(tree, scanned[0]);
+        }
+        auto t1 = steady_clock::now();
+        size_t heap = heapInUse() - heapBefore, allocs = allocations->count;
+        allocations.reset();
+        double walk = 1e9;
+        for (int round = 0; round < 5; round++) {
+            auto a = steady_clock::now();
+            size_t found = 0;
+            vector<LegacyTreeNode*> stack = {tree};
+            while (!stack.empty()) {
+                LegacyTreeNode* node = stack.back();
+                stack.pop_back();
+                if (node->name == missing) found++;
+                for (const auto& [name, child] : node->children) stack.push_back(child);
+            }
+            walk = min(walk, seconds(a, steady_clock::now()));
+            sink += found;
+        }
+        auto t2 = steady_clock::now();
+        legacyDelete(tree);
+        row("map<string, TreeNode*>", seconds(t0, t1), heap, allocs, walk, seconds(t2, steady_clock::now()));
+    }
+    {
+        size_t heapBefore = heapInUse();
+        unique_ptr<AllocationCounter> allocations(new AllocationCounter());
+        auto t0 = steady_clock::now();
+        unique_ptr<DirectoryTree> tree(new DirectoryTree(root, false));
+        tree->expandSubtree(tree->root, root);
+        auto t1 = steady_clock::now();
+        size_t heap = heapInUse() - heapBefore, allocs = allocations->count;
+        allocations.reset();
+        double walk = 1e9;
+        for (int round = 0; round < 5; round++) {
+            auto a = steady_clock::now();
+            size_t found = 0;
+            vector<NodeId> stack = {tree->root};
+            while (!stack.empty()) {
+                NodeId node = stack.back();
+                stack.pop_back();
+                if (tree->nameOf(node) == missing) found++;
+                for (NodeId child : tree->children(node)) stack.push_back(child);
+            }
+            walk = min(walk, seconds(a, steady_clock::now()));
+            sink += found;
+        }
+        size_t arenaBytes = tree->memoryUsage();
+        // The same miss through the name index, and a glob over the sorted names.
+        auto a = steady_clock::now();
+        sink += tree->findByName(missing).size();
+        auto b = steady_clock::now();
+        size_t globMatches = tree->findMatching("*.h").size();
+        auto c = steady_clock::now();
+        auto t2 = steady_clock::now();
+        tree.reset();
+        row("arena + string pool", seconds(t0, t1), heap, allocs, walk, seconds(t2, steady_clock::now()));
+        ss << "Arena: " << fixed << setprecision(2) << arenaBytes / 1048576.0 << " MB reserved, "
+           << sizeof(TreeNode) << " B per node + 4 B per child slot + interned names\n";
+        ss << "Name index: exact lookup " << setprecision(1) << seconds(a, b) * 1e6 << " us, glob '*.h' "
+           << setprecision(2) << seconds(b, c) * 1000 << " ms (" << globMatches << " matches)";
+    }
+    return ss.str();
+}
+
+}  // namespace
+
+string naapoCommand(const string& arg) {
+    string suite = arg.substr(0, arg.find(' '));
+    size_t space = arg.find(' ');
+    string rest = space == string::npos ? "" : arg.substr(space + 1);
+    if (suite == "huffman") return benchHuffman();
+    if (suite == "codec") return benchCodecs(rest);
+    if (suite == "search") return benchSearch(rest);
+    if (suite == "scan") return benchScan(rest);
+    if (suite == "tree") return benchTree(rest);
+    return "Bhai! Benchmark chunno: naapo huffman | naapo codec [file] | naapo search [MB] | naapo scan [dir] | "
+           "naapo tree [dir]";
+}
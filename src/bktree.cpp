@@ -0,0 +1,131 @@
+#include "bktree.h"
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+
+// Myers' bit-parallel global edit distance for a (1..64 bytes) against b: one word holds
+// the vertical deltas of a whole DP column. peq must be all zero on entry and is left so.
+size_t bitParallelDistance(string_view a, string_view b, size_t bound, uint64_t* peq) {
+    const size_t n = a.size(), m = b.size();
+    for (size_t i = 0; i < n; i++) peq[static_cast<unsigned char>(a[i])] |= uint64_t(1) << i;
+    const uint64_t high = uint64_t(1) << (n - 1);
+    uint64_t pv = ~uint64_t(0), mv = 0;
+    size_t score = n;
+    size_t result = SIZE_MAX;
+    for (size_t j = 0; j < m; j++) {
+        uint64_t eq = peq[static_cast<unsigned char>(b[j])];
+        uint64_t xv = eq | mv;
+        uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+        uint64_t ph = mv | ~(xh | pv);
+        uint64_t mh = pv & xh;
+        if (ph & high) score++;
+        else if (mh & high) score--;
+        ph = (ph << 1) | 1;  // top row is 0, 1, 2, ...: +1 across every column
+        mh <<= 1;
+        pv = mh | ~(xv | ph);
+        mv = ph & xv;
+        // The last row can drop by at most one per remaining column.
+        if (score > bound + (m - j - 1)) {
+            result = bound + 1;
+            break;
+        }
+    }
+    for (size_t i = 0; i < n; i++) peq[static_cast<unsigned char>(a[i])] = 0;
+    return result != SIZE_MAX ? result : min(score, bound + 1);
+}
+
+}  // namespace
+
+size_t boundedEditDistance(string_view a, string_view b, size_t bound) {
+    if (a.size() > b.size()) swap(a, b);
+    const size_t n = a.size(), m = b.size();
+    if (m - n > bound) return bound + 1;
+    if (n == 0) return m;
+    bound = min(bound, m);
+    if (n <= 64) {
+        thread_local uint64_t peq[256] = {};
+        return bitParallelDistance(a, b, bound, peq);
+    }
+    const size_t over = bound + 1;
+
+    // One row over the shorter word; short words (the usual case) stay on the stack.
+    size_t stackRow[256];
+    vector<size_t> heapRow;
+    size_t* row = stackRow;
+    if (n >= 256) {
+        heapRow.resize(n + 1);
+        row = heapRow.data();
+    }
+    for (size_t j = 0; j <= n; j++) row[j] = j <= bound ? j : over;
+
+    for (size_t i = 1; i <= m; i++) {
+        size_t lo = i > bound ? i - bound : 1;
+        size_t hi = min(n, i + bound);
+        size_t diagonal = row[lo - 1];
+        // The cell left of the band is out of reach in this row.
+        row[lo - 1] = lo == 1 && i <= bound ? i : over;
+        size_t rowMin = row[lo - 1];
+        unsigned char c = b[i - 1];
+        for (size_t j = lo; j <= hi; j++) {
+            size_t above = row[j];
+            size_t value = min(diagonal + (static_cast<unsigned char>(a[j - 1]) != c), min(above, row[j - 1]) + 1);
+            diagonal = above;
+            row[j] = min(value, over);
+            rowMin = min(rowMin, row[j]);
+        }
+        if (rowMin > bound) return over;
+    }
+    return min(row[n], over);
+}
+
+bool BKTree::insert(const string& word) {
+    if (nodes.empty()) {
+        nodes.push_back(BKNode{word, 0, {}});
+        return true;
+    }
+    uint32_t index = 0;
+    while (true) {
+        size_t distance = boundedEditDistance(word, nodes[index].word, SIZE_MAX - 1);
+        if (distance == 0) return false;
+        uint32_t next = UINT32_MAX;
+        for (const auto& [edge, child] : nodes[index].children)
+            if (edge == distance) next = child;
+        if (next == UINT32_MAX) {
+            uint32_t added = static_cast<uint32_t>(nodes.size());
+            nodes[index].children.emplace_back(static_cast<uint32_t>(distance), added);
+            nodes[index].maxEdge = max(nodes[index].maxEdge, static_cast<uint32_t>(distance));
+            nodes.push_back(BKNode{word, 0, {}});
+            return true;
+        }
+        index = next;
+    }
+}
+
+vector<BKTree::Suggestion> BKTree::closest(string_view query, size_t maxDistance, size_t limit) const {
+    vector<pair<size_t, uint32_t>> found;  // (distance, node index), kept sorted
+    if (nodes.empty() || limit == 0) return {};
+    size_t radius = maxDistance;
+    vector<uint32_t> pending = {0};
+    while (!pending.empty()) {
+        uint32_t index = pending.back();
+        pending.pop_back();
+        const BKNode& node = nodes[index];
+        // Exact up to radius + maxEdge: beyond that no child edge is within reach either.
+        size_t bound = radius > SIZE_MAX - 1 - node.maxEdge ? SIZE_MAX - 1 : radius + node.maxEdge;
+        size_t distance = boundedEditDistance(query, node.word, bound);
+        if (distance <= radius) {
+            pair<size_t, uint32_t> entry(distance, index);
+            found.insert(upper_bound(found.begin(), found.end(), entry), entry);
+            if (found.size() > limit) found.pop_back();
+            if (found.size() == limit) radius = found.back().first;
+        }
+        if (distance > bound) continue;
+        for (const auto& [edge, child] : node.children)
+            if (edge + radius >= distance && edge <= distance + radius) pending.push_back(child);
+    }
+    vector<Suggestion> suggestions;
+    for (const auto& [distance, index] : found) suggestions.push_back({&nodes[index].word, distance});
+    return suggestions;
+}
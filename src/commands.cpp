@@ -3,6 +3,17 @@
 #include "hashtable.h"
 #include "datastructure.h"
 #include "huffman.h"
+#include "threadpool.h"
+#include "benchmark.h"
+#include "archive.h"
+#include "search.h"
+#include "mappedfile.h"
+#include "ahocorasick.h"
+#include "trigramindex.h"
+#include "regexdfa.h"
+#include "fuzzy.h"
+#include "commandregistry.h"
+#include "bktree.h"
 #include <bits/stdc++.h>
 #include <chrono>
 #include <fstream>
@@ -25,23 +36,26 @@ string trim(const string &str) {
     return str.substr(first, (last - first + 1));
 }
 
-int levenshteinDistance(const string &s1, const string &s2) {
-    int len1 = s1.size(), len2 = s2.size();
-    vector<vector<int>> dp(len1 + 1, vector<int>(len2 + 1, 0));
-    for (int i = 0; i <= len1; i++) dp[i][0] = i;
-    for (int j = 0; j <= len2; j++) dp[0][j] = j;
+const string NUMBER_TOO_BIG = "Bhai! number bahut bada hai.";
 
-    for (int i = 1; i <= len1; i++) {
-        for (int j = 1; j <= len2; j++) {
-            dp[i][j] = (s1[i - 1] == s2[j - 1]) 
-                        ? dp[i - 1][j - 1] 
-                        : 1 + min({dp[i - 1][j], dp[i][j - 1], dp[i - 1][j - 1]});
-        }
-    }
-    return dp[len1][len2];
+// Reads a run of decimal digits into `value`. False if `digits` is empty, has anything
+// but digits, or does not fit in a size_t.
+bool parseNumber(const string &digits, size_t &value) {
+    const char *end = digits.data() + digits.size();
+    auto [stop, error] = from_chars(digits.data(), end, value);
+    return !digits.empty() && error == errc() && stop == end;
 }
 
-string reportPerformance(const string& operation, const string& timeComplexity, const string& spaceComplexity, const steady_clock::time_point& start) {
+// "\nKya tum '<path>' kehna chahte the?" when the directory tree has a name close to the
+// last component of a path that was not found; empty otherwise.
+string didYouMean(const string &path) {
+    size_t slash = path.find_last_of('/');
+    string directory = slash == string::npos ? "" : path.substr(0, slash + 1);
+    string suggestion = directoryTree.suggestName(path.substr(directory.size()));
+    return suggestion.empty() ? "" : "\nKya tum '" + directory + suggestion + "' kehna chahte the?";
+}
+
+string reportPerformance(const string& operation, const string& timeComplexity, const string& spaceComplexity, const steady_clock::time_point& start, size_t bytesProcessed = 0) {
     auto end = steady_clock::now();
     auto duration = duration_cast<microseconds>(end - start).count();
 
@@ -50,6 +64,9 @@ string reportPerformance(const string& operation, const string& timeComplexity,
        << "\n\u23f1\ufe0f Time taken: " << duration << " \u03bcs"
        << "\n\U0001f9e0 Time Complexity: " << timeComplexity
        << "\n\U0001f4be Space Complexity: " << spaceComplexity;
+    if (bytesProcessed > 0 && duration > 0)
+        ss << "\n\U0001f680 Throughput: " << fixed << setprecision(2)
+           << (bytesProcessed / 1048576.0) / (duration / 1e6) << " MB/s";
     return ss.str();
 }
 
@@ -63,6 +80,7 @@ string banaoCommand(const string &fileName) {
             HashTable::Metadata metadata{fileName, fileInfo.st_size, ctime(&fileInfo.st_mtime)};
             metadata.lastModified.erase(remove(metadata.lastModified.begin(), metadata.lastModified.end(), '\n'), metadata.lastModified.end());
             metadataTable.insertFileMetadata(fileName, metadata);
+            directoryTree.noteCreated(fileName, false);
             result = "Bhai! File '" + fileName + "' ban gaya aur metadata store ho gaya!";
         }
     } else {
@@ -75,8 +93,9 @@ string banaoCommand(const string &fileName) {
 string dikhaoCommand() {
     auto start = steady_clock::now();
     string output = "Bhai! Files ka list dikhao...\n";
-    for (const auto &[name, node] : directoryTree.current->children)
-        output += "- " + name + "\n";
+    directoryTree.expand(directoryTree.current);
+    for (NodeId child : directoryTree.children(directoryTree.current))
+        output += "- " + string(directoryTree.nameOf(child)) + "\n";
     output += reportPerformance("dikhao", "O(n)", "O(1)", start);
     return output;
 }
@@ -86,85 +105,425 @@ string mitaoCommand(const string &fileName) {
     string result;
     if (remove(fileName.c_str()) == 0) {
         metadataTable.removeFileMetadata(fileName);
+        directoryTree.noteRemoved(fileName);
         result = "Bhai! File '" + fileName + "' mita diya gaya!";
     } else {
-        result = "Bhai! Error: File '" + fileName + "' nahi mita!";
+        result = "Bhai! Error: File '" + fileName + "' nahi mita!" + didYouMean(fileName);
     }
     result += reportPerformance("mitao", "O(1)", "O(1)", start);
     return result;
 }
 
-vector<int> preprocessBadChar(const string &pattern) {
-    vector<int> badChar(256, -1);
-    for (int i = 0; i < pattern.size(); i++)
-        badChar[pattern[i]] = i;
-    return badChar;
-}
+// dhoondo [-r] [-j N] [-m MB] [-x | -k N] [-c | -l | -n N] [-e <pattern>]... [-f <pattern file>] <file> [<pattern>]
+// With no -e/-f the rest of the line after the file name is the single pattern; with -r
+// there is no file name and every file under the current directory is searched.
+// -c only counts, -l only says whether there is a match, -n N lists the first N (per file
+// with -r); all three stop scanning as soon as the answer is known.
+// -x treats the patterns as regular expressions (see regexdfa.h); several are OR-ed into one,
+// so ^ and $ only work with a single -x pattern.
+// -k N finds a single pattern with up to N typos (edit distance, see fuzzy.h).
+// -m MB sets the search result cache budget for the rest of the session (0 turns it off).
+struct DhoondoOptions {
+    vector<string> patterns;
+    string fileName;
+    bool recursive = false;
+    bool regex = false;
+    bool fuzzy = false;
+    size_t maxErrors = 0;  // -k
+    size_t threads = 0;  // 0: one worker per core
+    bool countOnly = false;
+    bool existsOnly = false;
+    size_t maxMatches = SIZE_MAX;
+    size_t cacheBudgetMB = SIZE_MAX;  // -m; SIZE_MAX: keep the current budget
+};
 
-vector<int> boyerMooreSearch(const string &text, const string &pattern) {
-    int m = pattern.size(), n = text.size();
-    vector<int> badChar = preprocessBadChar(pattern);
-    vector<int> result;
-    int shift = 0;
-
-    while (shift <= (n - m)) {
-        int j = m - 1;
-        while (j >= 0 && pattern[j] == text[shift + j]) j--;
-        if (j < 0) {
-            result.push_back(shift);
-            shift += (shift + m < n) ? m - badChar[text[shift + m]] : 1;
+string parseDhoondoOptions(const string &arg, DhoondoOptions &options) {
+    string rest = trim(arg);
+    auto nextWord = [&rest]() {
+        size_t end = rest.find(' ');
+        string word = rest.substr(0, end);
+        rest = end == string::npos ? "" : trim(rest.substr(end + 1));
+        return word;
+    };
+    while (rest.size() >= 2 && rest[0] == '-' && (rest.size() == 2 || rest[2] == ' ')) {
+        char flag = rest[1];
+        if (string("efrjclnxkm").find(flag) == string::npos) break;
+        rest = trim(rest.substr(2));
+        if (flag == 'r' || flag == 'c' || flag == 'l' || flag == 'x') {
+            if (flag == 'r') options.recursive = true;
+            else if (flag == 'x') options.regex = true;
+            else if (flag == 'c') options.countOnly = true;
+            else options.existsOnly = true;
+            continue;
+        }
+        string value = nextWord();
+        if (value.empty()) return "Bhai! '-" + string(1, flag) + "' ke baad kuch to likho.";
+        bool number = all_of(value.begin(), value.end(), ::isdigit);
+        size_t parsed = 0;
+        if (number && (flag == 'j' || flag == 'n' || flag == 'k' || flag == 'm') && !parseNumber(value, parsed))
+            return NUMBER_TOO_BIG;
+        if (flag == 'j') {
+            options.threads = parsed;
+        } else if (flag == 'n') {
+            if (!number || parsed == 0) return "Bhai! '-n' ke baad 1 ya zyada ka number do.";
+            options.maxMatches = parsed;
+        } else if (flag == 'k') {
+            if (!number) return "Bhai! '-k' ke baad typos ki ginti (number) do.";
+            options.fuzzy = true;
+            options.maxErrors = parsed;
+        } else if (flag == 'm') {
+            if (!number || parsed > PATTERN_CACHE_MAX_BUDGET_MB)
+                return "Bhai! '-m' ke baad cache ka size MB mein do (0 se " + to_string(PATTERN_CACHE_MAX_BUDGET_MB) + " tak).";
+            options.cacheBudgetMB = parsed;
+        } else if (flag == 'e') {
+            options.patterns.push_back(value);
         } else {
-            shift += max(1, j - badChar[text[shift + j]]);
+            ifstream patternFile(value);
+            if (!patternFile) return "Bhai! Pattern file '" + value + "' nahi mili.";
+            string line;
+            while (getline(patternFile, line)) {
+                if (!line.empty() && line.back() == '\r') line.pop_back();
+                if (!line.empty()) options.patterns.push_back(line);
+            }
         }
     }
-    return result;
+    if (!options.recursive) options.fileName = nextWord();
+    if (options.patterns.empty() && !rest.empty()) options.patterns.push_back(rest);
+    if (options.recursive && options.patterns.empty()) return "Bhai! 'dhoondo -r' ke saath pattern bhi do.";
+    if ((options.fileName.empty() && !options.recursive) || options.patterns.empty())
+        return "Bhai! File aur pattern dono specify karo.";
+
+    // Repeated patterns would only double-report.
+    vector<string> unique;
+    for (const string &pattern : options.patterns)
+        if (find(unique.begin(), unique.end(), pattern) == unique.end()) unique.push_back(pattern);
+    options.patterns.swap(unique);
+    if (options.fuzzy) {
+        if (options.regex) return "Bhai! '-k' aur '-x' ek saath nahi chalte.";
+        if (options.patterns.size() > 1) return "Bhai! '-k' ke saath ek hi pattern do.";
+        if (options.maxErrors >= options.patterns[0].size())
+            return "Bhai! '-k' pattern ki length (" + to_string(options.patterns[0].size()) +
+                   ") se kam hona chahiye, warna har jagah match hoga.";
+    }
+    if (options.regex && options.patterns.size() > 1) {
+        string alternation;
+        for (const string &pattern : options.patterns) alternation += (alternation.empty() ? "(" : "|(") + pattern + ")";
+        options.patterns.assign(1, alternation);
+    }
+    return "";
 }
 
-string dhoondoCommand(const string &fileName, const string &pattern) {
-    auto start = steady_clock::now();
-    ifstream file(fileName);
-    if (!file) return "Bhai! File '" + fileName + "' nahi mil rahi.";
-
-    string line;
-    int lineNum = 0;
-    int totalChars = 0;
-    set<int> matchedLines;
-    vector<pair<int, int>> occurrences;
-
-    // Read the file line-by-line (stream-based)
-    while (getline(file, line)) {
-        lineNum++;
-        totalChars += line.length();
-        
-        // Apply Boyer-Moore Search on the current line
-        vector<int> matches = boyerMooreSearch(line, pattern);
-        for (int pos : matches) {
-            occurrences.emplace_back(lineNum, pos);
-            matchedLines.insert(lineNum);
+// Compiled patterns, shared read-only by every file one dhoondo command searches.
+struct DhoondoMatcher {
+    unique_ptr<AhoCorasick> automaton;  // several literal patterns
+    unique_ptr<RegexProgram> regex;     // -x
+    unique_ptr<FuzzyMatcher> fuzzy;     // -k
+};
+
+string compileMatcher(const DhoondoOptions &options, DhoondoMatcher &matcher) {
+    if (options.regex) {
+        string error;
+        matcher.regex.reset(new RegexProgram());
+        if (!matcher.regex->compile(options.patterns[0], error)) return error;
+    } else if (options.fuzzy) {
+        matcher.fuzzy.reset(new FuzzyMatcher(options.patterns[0], options.maxErrors));
+    } else if (options.patterns.size() > 1) {
+        matcher.automaton.reset(new AhoCorasick(options.patterns));
+    }
+    return "";
+}
+
+using DhoondoMatches = HashTable::PatternResult;
+
+// Searches one buffer for every pattern. The whole buffer is scanned at once and line
+// numbers are only worked out for matches (see LineLocator). One pattern goes through the
+// search kernel, several through the matcher's Aho-Corasick automaton, a fuzzy one through
+// its Myers matcher, and a regex through `searcher` (the caller's, since its DFA cache is
+// per thread).
+// In -c/-l modes only perPattern is filled: no occurrence list, no line numbers, no
+// line totals. Returns false when the scan stopped early (-l, -n), in which case the
+// line totals are left at zero as well.
+bool findMatches(const char *text, size_t size, const DhoondoOptions &options, const DhoondoMatcher &matcher,
+                 RegexSearcher *searcher, DhoondoMatches &matches) {
+    const vector<string> &patterns = options.patterns;
+    bool listing = !options.countOnly && !options.existsOnly;
+    size_t limit = options.existsOnly ? 1 : options.countOnly ? SIZE_MAX : options.maxMatches;
+    size_t found = 0;
+    bool complete = true;
+    matches.perPattern.assign(patterns.size(), 0);
+    LineLocator locator(text, size);
+    size_t lastLine = 0;
+    // Matches are reported by start offset, except from Aho-Corasick, which reports them
+    // by end offset: there a start can precede an earlier match's start but never crosses
+    // back over a newline, so the locator is fed the end and the column corrected.
+    auto record = [&](size_t index, size_t offset, size_t back) {
+        matches.perPattern[index]++;
+        if (listing) {
+            size_t line, column;
+            locator.locate(offset, line, column);
+            if (line != lastLine) matches.matchedLines++;
+            lastLine = line;
+            matches.occurrences.emplace_back(line, column - back, index);
         }
+        complete = ++found < limit;
+        return complete;
+    };
+    if (searcher) {
+        size_t begin, end;
+        // An empty match ("^$" on an empty line) moves the search on by one byte.
+        for (size_t from = 0; searcher->nextMatch(text, size, from, begin, end); from = end > begin ? end : end + 1)
+            if (!record(0, begin, 0)) break;
+    } else if (matcher.fuzzy) {
+        size_t begin, end, distance;
+        for (size_t from = 0; matcher.fuzzy->nextMatch(text, size, from, begin, end, distance); from = end)
+            if (!record(0, begin, 0)) break;
+    } else if (patterns.size() == 1) {
+        const string &pattern = patterns[0];
+        for (size_t pos = searchFirst(text, size, pattern.data(), pattern.size()); pos != SEARCH_NPOS;
+             pos = searchFirst(text, size, pattern.data(), pattern.size(), pos + 1))
+            if (!record(0, pos, 0)) break;
+    } else {
+        matcher.automaton->scan(text, size, [&](size_t index, size_t end) { return record(index, end, patterns[index].size()); });
+    }
+    if (listing && complete) {
+        matches.newlines = locator.totalNewlines();
+        matches.lines = matches.newlines + (size > 0 && text[size - 1] != '\n' ? 1 : 0);
     }
+    return complete;
+}
+
+string dhoondoCommand(const DhoondoOptions &options) {
+    auto start = steady_clock::now();
+    const string &fileName = options.fileName;
+    const vector<string> &patterns = options.patterns;
+    bool listing = !options.countOnly && !options.existsOnly;
 
-    struct stat fileInfo;
-    double fileSizeKB = 0.0;
-    if (stat(fileName.c_str(), &fileInfo) == 0) {
-        fileSizeKB = fileInfo.st_size / 1024.0; // Convert size to KB
+    // Repeated searches of an unchanged file are answered from metadataTable's cache
+    // without opening the file. Only complete listings are stored; every mode can be
+    // answered from one.
+    DhoondoMatcher matcher;
+    string error = compileMatcher(options, matcher);
+    if (!error.empty()) return error;
+    unique_ptr<RegexSearcher> searcher(options.regex ? new RegexSearcher(*matcher.regex) : nullptr);
+    string cacheKey = options.regex ? string("-x") + '\0' : options.fuzzy ? "-k " + to_string(options.maxErrors) + '\0' : "";
+    for (size_t i = 0; i < patterns.size(); i++) cacheKey += (i ? string(1, '\0') : "") + patterns[i];
+    HashTable::FileStamp stamp;
+    bool stamped = HashTable::stampFile(fileName, stamp);
+    const DhoondoMatches *cached = stamped ? metadataTable.findPatternResult(fileName, cacheKey, stamp) : nullptr;
+    DhoondoMatches scanned;
+    bool complete = true;
+    if (!cached) {
+        MappedFile file(fileName);
+        if (!file.isOpen()) return "Bhai! File '" + fileName + "' nahi mil rahi." + didYouMean(fileName);
+        complete = findMatches(file.data(), file.size(), options, matcher, searcher.get(), scanned);
+        if (stamped && listing && complete) metadataTable.storePatternResult(fileName, cacheKey, stamp, scanned);
     }
+    const DhoondoMatches &matches = cached ? *cached : scanned;
+    size_t total = accumulate(matches.perPattern.begin(), matches.perPattern.end(), size_t(0));
+    size_t shown = listing ? std::min(matches.occurrences.size(), options.maxMatches) : 0;
+
+    // Same line/char totals the getline loop reported: a trailing partial line counts as a
+    // line, and newline bytes are not text.
+    size_t size = stamp.size;
+    size_t lineCount = matches.lines;
+    size_t totalChars = size - matches.newlines;
+    double fileSizeKB = size / 1024.0;
 
+    string label = options.regex ? "Regex '" + patterns[0] + "'"
+                 : options.fuzzy ? "Pattern '" + patterns[0] + "' (" + to_string(options.maxErrors) + " typos tak)"
+                 : patterns.size() == 1 ? "Pattern '" + patterns[0] + "'" : to_string(patterns.size()) + " patterns";
     // Prepare output message
-    string output = occurrences.empty()
-        ? "Bhai! Pattern '" + pattern + "' file '" + fileName + "' mein nahi mila."
-        : "Bhai! Pattern '" + pattern + "' mila:\n";
+    string output;
+    if (options.existsOnly)
+        output = "Bhai! " + label + " file '" + fileName + "' mein " + (total ? "hai!" : "nahi hai.");
+    else if (options.countOnly)
+        output = "Bhai! " + label + " file '" + fileName + "' mein " + to_string(total) + " baar mila.";
+    else
+        output = total == 0 ? "Bhai! " + label + " file '" + fileName + "' mein nahi mila."
+                            : "Bhai! " + label + " mila:\n";
 
-    for (auto &[line, pos] : occurrences)
-        output += "Line " + to_string(line) + ", Position " + to_string(pos) + "\n";
+    for (size_t i = 0; i < shown; i++) {
+        auto &[line, pos, index] = matches.occurrences[i];
+        output += "Line " + to_string(line) + ", Position " + to_string(pos);
+        output += patterns.size() == 1 ? "\n" : " ('" + patterns[index] + "')\n";
+    }
 
-    output += "\n\U0001f50d Matches: " + to_string(occurrences.size()) + " in " +
-              to_string(matchedLines.size()) + " different lines";
-    output += "\n\U0001f4c4 File Size: " + to_string(fileSizeKB).substr(0, 4) + " KB | \U0001f4cf Lines: " + to_string(lineNum);
-    output += "\n\U0001f520 Text Length: " + to_string(totalChars) + " chars | \U0001f50d Pattern Length: " + to_string(pattern.size());
+    if (patterns.size() > 1 && !options.existsOnly) {
+        output += "\n\U0001f4ca Har pattern ke matches" + string(complete ? "" : " (jitne scan hue)") + ":";
+        for (size_t i = 0; i < patterns.size(); i++)
+            output += "\n  '" + patterns[i] + "': " + to_string(matches.perPattern[i]);
+    }
+    size_t patternLength = 0;
+    for (const string &pattern : patterns) patternLength += pattern.size();
+    if (listing && complete) {
+        output += "\n\U0001f50d Matches: " + to_string(total) + " in " + to_string(matches.matchedLines) + " different lines";
+        if (shown < total) output += " (pehle " + to_string(shown) + " dikhaye)";
+    } else if (listing) {
+        output += "\n\u23f9\ufe0f Pehle " + to_string(shown) + " matches ke baad scan rok diya";
+    }
+    output += "\n\U0001f4c4 File Size: " + to_string(fileSizeKB).substr(0, 4) + " KB";
+    if (listing && complete) {
+        output += " | \U0001f4cf Lines: " + to_string(lineCount);
+        output += "\n\U0001f520 Text Length: " + to_string(totalChars) + " chars | \U0001f50d Pattern Length: " + to_string(patternLength);
+    }
+    output += "\n\U0001f5c3\ufe0f Cache: " + string(cached ? "hit" : "miss") + " (hits " +
+              to_string(metadataTable.patternCacheHits()) + ", misses " + to_string(metadataTable.patternCacheMisses()) +
+              ", " + to_string(metadataTable.patternCacheBytes() / 1024) + " / " +
+              to_string(metadataTable.patternCacheBudget() / 1024) + " KB)";
 
     // Include performance report
-    output += reportPerformance("dhoondo", "O(n + m)", "O(m)", start);
+    // An early stop leaves the scanned byte count unknown, so no throughput for it.
+    size_t scannedBytes = complete ? size : 0;
+    if (searcher && !cached)
+        output += "\n\U0001f916 DFA: " + to_string(searcher->statesBuilt()) + " states, " +
+                  to_string(searcher->cacheFlushes()) + " cache flushes | Literal prefilter: " +
+                  (matcher.regex->requiredLiteral().empty() ? "none" : "'" + matcher.regex->requiredLiteral() + "'");
+    if (cached) output += reportPerformance("dhoondo (cache)", "O(matches)", "O(matches)", start);
+    else if (searcher) output += reportPerformance("dhoondo (regex DFA)", "O(n)", "O(DFA cache)", start, scannedBytes);
+    else if (options.fuzzy)
+        output += reportPerformance("dhoondo (fuzzy, Myers bit-parallel)", "O(n * (k / 64 + 1))", "O(m)", start, scannedBytes);
+    else if (patterns.size() == 1) output += reportPerformance("dhoondo", "O(n + m)", "O(m)", start, scannedBytes);
+    else output += reportPerformance("dhoondo (Aho-Corasick)", "O(n + sum(m) + matches)", "O(sum(m) * classes)", start, scannedBytes);
+    return output;
+}
+
+// "dhoondo -r": searches every file under the current directory of the tree. Files are
+// handed to a work-stealing pool one task each; results are collected per file and
+// appended to the output in path order as soon as every earlier file is done, so the
+// output is the same for any thread count and finished files do not pile up in memory.
+string dhoondoRecursiveCommand(const DhoondoOptions &options) {
+    auto start = steady_clock::now();
+    const vector<string> &patterns = options.patterns;
+    vector<string> paths = directoryTree.leafPaths();
+    string base = directoryTree.getCurrentPath();
+    if (base.back() != '/') base += '/';
+    DhoondoMatcher matcher;
+    string error = compileMatcher(options, matcher);
+    if (!error.empty()) return error;
+
+    // With a "suchi" index in this directory, files it still vouches for (same size and
+    // mtime) are only opened when they contain every trigram of some pattern; anything
+    // new or changed since the index was built is searched as usual. A match with k typos
+    // still contains one of k + 1 disjoint pieces of the pattern exactly, so -k asks for
+    // any of those pieces.
+    TrigramIndex trigramIndex(base + TRIGRAM_INDEX_FILE);
+    vector<uint8_t> candidate;
+    if (trigramIndex.isOpen()) {
+        vector<string> required = patterns;
+        if (options.regex) {
+            required.assign(1, matcher.regex->requiredLiteral());
+        } else if (options.fuzzy) {
+            size_t pieces = options.maxErrors + 1, length = patterns[0].size();
+            required.clear();
+            for (size_t i = 0; i < pieces; i++)
+                required.push_back(patterns[0].substr(i * length / pieces, (i + 1) * length / pieces - i * length / pieces));
+        }
+        for (const string &pattern : required) trigramIndex.markCandidates(pattern, candidate);
+    }
+
+    enum FileState { PENDING, MATCHED, NO_MATCH, BINARY, UNREADABLE, NOT_FILE, PRUNED };
+    struct FileResult {
+        FileState state = PENDING;
+        string text;  // formatted matches
+        size_t matches = 0, bytes = 0;
+        vector<size_t> perPattern;
+    };
+    vector<FileResult> results(paths.size());
+
+    string listing;
+    size_t flushed = 0, filesMatched = 0, totalMatches = 0, binaries = 0, unreadable = 0, scanned = 0, pruned = 0;
+    uint64_t bytesScanned = 0;
+    vector<size_t> perPattern(patterns.size(), 0);
+    mutex flushLock;
+    // Caller holds flushLock. Moves every finished file at the front of the queue into the
+    // listing and totals.
+    auto flush = [&]() {
+        while (flushed < results.size() && results[flushed].state != PENDING) {
+            FileResult &result = results[flushed];
+            if (result.state == BINARY) binaries++;
+            else if (result.state == UNREADABLE) unreadable++;
+            else if (result.state == PRUNED) pruned++;
+            else if (result.state != NOT_FILE) scanned++;
+            bytesScanned += result.bytes;
+            if (result.state == MATCHED) {
+                filesMatched++;
+                totalMatches += result.matches;
+                for (size_t i = 0; i < perPattern.size(); i++) perPattern[i] += result.perPattern[i];
+                listing += paths[flushed] + result.text;
+            }
+            result = FileResult();
+            result.state = NO_MATCH;
+            flushed++;
+        }
+    };
+
+    auto searchFile = [&](const string &fullPath, FileResult &result) {
+        MappedFile file(fullPath);
+        struct stat info;
+        if (!file.isOpen()) {
+            // Empty directories are leaves of the tree too, as are devices and sockets.
+            bool notFile = stat(fullPath.c_str(), &info) == 0 && !S_ISREG(info.st_mode);
+            result.state = notFile ? NOT_FILE : UNREADABLE;
+            return;
+        }
+        if (looksBinary(file.data(), file.size())) {
+            result.state = BINARY;
+            return;
+        }
+        DhoondoMatches matches;
+        // Files cut short by -l/-n do not count towards the throughput.
+        unique_ptr<RegexSearcher> searcher(options.regex ? new RegexSearcher(*matcher.regex) : nullptr);
+        result.bytes = findMatches(file.data(), file.size(), options, matcher, searcher.get(), matches) ? file.size() : 0;
+        result.matches = accumulate(matches.perPattern.begin(), matches.perPattern.end(), size_t(0));
+        result.perPattern = matches.perPattern;
+        result.state = result.matches ? MATCHED : NO_MATCH;
+        if (options.countOnly) result.text = ": " + to_string(result.matches) + "\n";
+        else if (options.existsOnly) result.text = "\n";
+        else result.text = ":\n";
+        for (auto &[line, pos, index] : matches.occurrences) {
+            result.text += "  Line " + to_string(line) + ", Position " + to_string(pos);
+            result.text += patterns.size() == 1 ? "\n" : " ('" + patterns[index] + "')\n";
+        }
+    };
+
+    size_t threads = options.threads ? std::min(options.threads, ThreadPool::maxThreads()) : ThreadPool::defaultThreads();
+    ThreadPool pool(std::min(threads, std::max<size_t>(paths.size(), 1)));
+    for (size_t i = 0; i < paths.size(); i++) {
+        pool.submit([&, i] {
+            FileResult result;
+            string fullPath = base + paths[i];
+            int64_t id = trigramIndex.isOpen() ? trigramIndex.currentId(paths[i], fullPath) : -1;
+            if (id >= 0 && trigramIndex.isBinary(id)) result.state = BINARY;
+            else if (id >= 0 && !candidate[id]) result.state = PRUNED;
+            else searchFile(fullPath, result);
+            lock_guard<mutex> guard(flushLock);
+            results[i] = move(result);
+            flush();
+        });
+    }
+    pool.wait();
+
+    string label = options.regex ? "Regex '" + patterns[0] + "'"
+                 : options.fuzzy ? "Pattern '" + patterns[0] + "' (" + to_string(options.maxErrors) + " typos tak)"
+                 : patterns.size() == 1 ? "Pattern '" + patterns[0] + "'" : to_string(patterns.size()) + " patterns";
+    string output = filesMatched == 0
+        ? "Bhai! " + label + " " + directoryTree.getCurrentPath() + " ki kisi file mein nahi mila.\n"
+        : "Bhai! " + label + " " + to_string(filesMatched) + " files mein mila:\n" + listing;
+
+    if (patterns.size() > 1) {
+        output += "\n\U0001f4ca Har pattern ke matches:";
+        for (size_t i = 0; i < patterns.size(); i++)
+            output += "\n  '" + patterns[i] + "': " + to_string(perPattern[i]);
+        output += "\n";
+    }
+    output += "\U0001f50d Matches: " + to_string(totalMatches) + " in " + to_string(filesMatched) + " files";
+    output += "\n\U0001f4c2 Files scanned: " + to_string(scanned) + " | Binary skipped: " + to_string(binaries) +
+              " | Unreadable: " + to_string(unreadable);
+    if (trigramIndex.isOpen())
+        output += "\n\U0001f5c2\ufe0f Index (" + string(TRIGRAM_INDEX_FILE) + "): " + to_string(pruned) +
+                  " files bina khole skip kiye";
+    output += "\n\U0001f9f5 Threads: " + to_string(pool.size());
+    output += reportPerformance("dhoondo -r", "O(total bytes / threads)", "O(matches + threads)", start, bytesScanned);
     return output;
 }
 
@@ -180,97 +539,396 @@ string jaaneCommand(const string &fileName) {
     return result;
 }
 
-string padhCommand(const string &fileName) {
+string compressionSummary(size_t originalBytes, size_t compressedBytes) {
+    stringstream ss;
+    ss << fixed << setprecision(2)
+       << "\n\U0001f4e6 Original: " << originalBytes << " bytes | Compressed: " << compressedBytes << " bytes"
+       << " | Ratio: " << (originalBytes ? 100.0 * compressedBytes / originalBytes : 0.0) << "%";
+    return ss.str();
+}
+
+// Options shared by likh and padh: "-f" (file to file), "-j N" (worker threads, 0 for one
+// per core), "-b KB" (block container with this block size for likh), "-z" (LZ77 + Huffman
+// codec for likh, always in the block container).
+// Returns what is left after the options; an unknown flag or a bad value sets `error`.
+struct CodecOptions {
+    bool fileMode = false;
+    size_t threads = 1;
+    size_t blockSize = HUFFMAN_DEFAULT_BLOCK_SIZE;
+    uint8_t codec = HUFFMAN_CODEC_ORDER0;
+    bool blocked = false;  // -b or -z: version 2 container
+    string error;  // usage message for the first unusable option
+};
+
+string parseCodecOptions(const string &arg, CodecOptions &options) {
+    string rest = trim(arg);
+    while (rest.size() >= 2 && rest[0] == '-' && (rest.size() == 2 || rest[2] == ' ')) {
+        char flag = rest[1];
+        rest = trim(rest.substr(2));
+        if (flag == 'f' || flag == 'z') {
+            if (flag == 'f') {
+                options.fileMode = true;
+            } else {
+                options.codec = HUFFMAN_CODEC_LZ77;
+                options.blocked = true;
+            }
+            continue;
+        }
+        if (flag != 'j' && flag != 'b') {
+            options.error = "Bhai! '-" + string(1, flag) + "' option nahi pata. Options: -f, -z, -j N, -b KB.";
+            return rest;
+        }
+        size_t end = rest.find(' ');
+        string number = rest.substr(0, end);
+        rest = end == string::npos ? "" : trim(rest.substr(end + 1));
+        size_t value = 0;
+        bool parsed = parseNumber(number, value);
+        if (flag == 'j') {
+            if (!parsed || value > ThreadPool::maxThreads()) {
+                options.error = "Bhai! '-j' ke baad 0 se " + to_string(ThreadPool::maxThreads()) +
+                                " tak threads ka number do (0: har core ke liye ek).";
+                return rest;
+            }
+            options.threads = value ? value : ThreadPool::defaultThreads();
+        } else {
+            if (!parsed || value == 0 || value > UINT32_MAX / 1024) {
+                options.error = "Bhai! '-b' ke baad block size KB mein do (1 se " + to_string(UINT32_MAX / 1024) + " tak).";
+                return rest;
+            }
+            options.blockSize = value * 1024;
+            options.blocked = true;
+        }
+    }
+    return rest;
+}
+
+string padhCommand(const string &fileName, size_t threads = 1) {
     auto start = steady_clock::now();
-    ifstream file(fileName);
-    string result;
+    ifstream file(fileName, ios::binary);
+    string result, decompressed;
     if (file) {
-        stringstream buffer;
-        buffer << file.rdbuf();
-        string fileContent = buffer.str();
+        file.seekg(0, ios::end);
+        string fileContent(static_cast<size_t>(max<streamoff>(file.tellg(), 0)), '\0');
+        file.seekg(0);
+        file.read(&fileContent[0], fileContent.size());
 
         size_t delimiterPos = fileContent.find("\n====\n");
-        if (delimiterPos != string::npos) {
+        if (isHuffmanContainer(fileContent)) {
+            if (decompressHuffman(fileContent, decompressed, threads)) {
+                result = "Bhai! Yeh raha decompress karke file '" + fileName + "' ka content (" +
+                         huffmanCodecName(huffmanContainerCodec(fileContent)) + "):\n" + decompressed;
+                result += compressionSummary(decompressed.size(), fileContent.size());
+            } else {
+                result = "Bhai! File '" + fileName + "' ka compressed data kharab hai.";
+            }
+        } else if (delimiterPos != string::npos) {
             string codeMapStr = fileContent.substr(0, delimiterPos);
-            string binaryData = fileContent.substr(delimiterPos + 7);
+            string binaryData = fileContent.substr(delimiterPos + 6);
             auto codeMap = deserializeCodeMap(codeMapStr);
-            string decompressed = decompressText(binaryData, codeMap);
-            result = "Bhai! Yeh raha decompress karke file '" + fileName + "' ka content:\n" + decompressed;
+            decompressed = decompressText(binaryData, codeMap);
+            result = "Bhai! Yeh raha decompress karke file '" + fileName + "' ka content (purana format):\n" + decompressed;
+            result += compressionSummary(decompressed.size(), fileContent.size());
         } else {
             result = "Bhai! Format gadbad hai ya compression use nahi hua tha.";
         }
     } else {
-        result = "Bhai! File '" + fileName + "' nahi mil raha!";
+        result = "Bhai! File '" + fileName + "' nahi mil raha!" + didYouMean(fileName);
     }
-    result += reportPerformance("padh (Huffman)", "O(n)", "O(n)", start);
+    result += reportPerformance("padh (Huffman)", "O(n)", "O(n)", start, decompressed.size());
     return result;
 }
 
-string likhCommand(const string &fileName, const string &content) {
+string likhCommand(const string &fileName, const string &content, const CodecOptions &options = CodecOptions()) {
     auto start = steady_clock::now();
-    string compressed = compressText(content);
-    ofstream file(fileName);
+    // The single-table format is the most compact for short text; block and LZ77
+    // containers are only used when asked for with -b or -z. -j only speeds up a block
+    // container and never changes which format is written.
+    string compressed = options.blocked
+        ? compressHuffmanBlocks(content, options.blockSize, options.threads, options.codec)
+        : compressHuffman(content);
+    ofstream file(fileName, ios::binary);
     string result = file
         ? (file << compressed, "Bhai! File '" + fileName + "' mein compress karke likh diya gaya!")
         : "Bhai! File '" + fileName + "' nahi bana sakte!";
-    result += reportPerformance("likh (Huffman)", "O(n log n)", "O(n)", start);
+    if (file) result += compressionSummary(content.size(), compressed.size());
+    result += reportPerformance(string("likh (") + huffmanCodecName(options.codec) + ")", "O(n)", "O(n)", start, content.size());
+    return result;
+}
+// Streaming variants: "likh -f <source> <dest>" and "padh -f <source> <dest>".
+string likhFileCommand(const string &source, const string &dest, const CodecOptions &options) {
+    auto start = steady_clock::now();
+    uint64_t originalBytes = 0, compressedBytes = 0;
+    string result = compressHuffmanFile(source, dest, originalBytes, compressedBytes, options.threads, options.blockSize, options.codec)
+        ? "Bhai! File '" + source + "' ko compress karke '" + dest + "' mein likh diya gaya! (" + huffmanCodecName(options.codec) + ", " +
+          to_string(options.threads) + " threads, " + to_string(options.blockSize / 1024) + " KB blocks)" +
+          compressionSummary(originalBytes, compressedBytes)
+        : "Bhai! File '" + source + "' ko '" + dest + "' mein compress nahi kar paye!";
+    result += reportPerformance(string("likh -f (") + huffmanCodecName(options.codec) + ", streaming)", "O(n / threads)", "O(threads * block)", start, originalBytes);
+    return result;
+}
+
+string padhFileCommand(const string &source, const string &dest, const CodecOptions &options) {
+    auto start = steady_clock::now();
+    uint64_t originalBytes = 0, compressedBytes = 0;
+    string result = decompressHuffmanFile(source, dest, originalBytes, compressedBytes, options.threads)
+        ? "Bhai! File '" + source + "' ko decompress karke '" + dest + "' mein likh diya gaya! (" +
+          to_string(options.threads) + " threads)" + compressionSummary(originalBytes, compressedBytes)
+        : "Bhai! File '" + source + "' decompress nahi hua (format gadbad ya file nahi mili).";
+    result += reportPerformance("padh -f (Huffman, streaming)", "O(n / threads)", "O(threads * block)", start, originalBytes);
+    return result;
+}
+
+// "baandho [-z] [-j N] <dir> <archive>": packs every file under <dir> of the directory tree.
+string baandhoCommand(const string &dirName, const string &archivePath, const CodecOptions &options) {
+    auto start = steady_clock::now();
+    if (!isSafeMemberPath(dirName))
+        return "Bhai! '" + dirName + "' current directory ke andar ka path nahi hai; andar ki directory do.";
+    string baseDir = directoryTree.getCurrentPath();
+    vector<string> files;
+    for (const string &path : directoryTree.subtreePaths(dirName)) {
+        struct stat info;
+        if (stat((baseDir + "/" + path).c_str(), &info) == 0 && S_ISREG(info.st_mode)) files.push_back(path);
+    }
+    if (files.empty()) return "Bhai! Directory '" + dirName + "' mein koi file nahi mili.";
+
+    vector<ArchiveMember> written;
+    vector<string> skipped;
+    if (!writeArchive(archivePath, baseDir, files, options.threads, options.codec, written, skipped))
+        return "Bhai! Archive '" + archivePath + "' nahi bana paye!";
+
+    uint64_t originalBytes = 0, compressedBytes = 0;
+    for (const auto &member : written) {
+        originalBytes += member.originalSize;
+        compressedBytes += member.compressedSize;
+    }
+    string result = "Bhai! " + to_string(written.size()) + " files '" + archivePath + "' mein baandh di! (" +
+                    huffmanCodecName(options.codec) + ", " + to_string(options.threads) + " threads)";
+    for (const string &path : skipped) result += "\nSkip kiya (padh nahi paye): " + path;
+    result += compressionSummary(originalBytes, compressedBytes);
+    result += reportPerformance("baandho", "O(n / threads)", "O(threads * file)", start, originalBytes);
+    return result;
+}
+
+// "suchi [-j N]": builds or refreshes the trigram index of the current directory that
+// "dhoondo -r" uses to skip files. Unchanged files keep their postings.
+string suchiCommand(size_t threads) {
+    auto start = steady_clock::now();
+    string baseDir = directoryTree.getCurrentPath();
+    string indexPath = (baseDir.back() == '/' ? baseDir : baseDir + "/") + TRIGRAM_INDEX_FILE;
+    TrigramIndexStats stats;
+    if (!updateTrigramIndex(baseDir, directoryTree.leafPaths(), indexPath, threads, stats))
+        return "Bhai! Index '" + indexPath + "' nahi bana paye!";
+
+    string result = "Bhai! Index taiyaar: " + indexPath;
+    result += "\n\U0001f4c2 Files: " + to_string(stats.files) + " (" + to_string(stats.scanned) + " padhi, " +
+              to_string(stats.reused) + " purani hi thi, " + to_string(stats.binaries) + " binary)";
+    result += "\n\U0001f524 Trigrams: " + to_string(stats.trigrams) + " | \U0001f4be Index Size: " +
+              to_string(stats.indexBytes / 1024) + " KB";
+    result += reportPerformance("suchi", "O(changed bytes / threads + postings)", "O(postings)", start, stats.bytesScanned);
+    return result;
+}
+
+// "kholo <archive>" lists the index; "kholo <archive> <member> [output]" extracts one member.
+string kholoCommand(const string &archivePath, const string &memberPath, const string &outputPath) {
+    auto start = steady_clock::now();
+    string result;
+    if (memberPath.empty()) {
+        vector<ArchiveMember> index;
+        if (!readArchiveIndex(archivePath, index)) return "Bhai! '" + archivePath + "' archive nahi lag raha.";
+        result = "Bhai! Archive '" + archivePath + "' mein " + to_string(index.size()) + " files hain:\n";
+        for (const auto &member : index)
+            result += "- " + member.path + " (" + to_string(member.originalSize) + " -> " +
+                      to_string(member.compressedSize) + " bytes)\n";
+        result += reportPerformance("kholo (index)", "O(members)", "O(members)", start);
+        return result;
+    }
+
+    if (outputPath.empty() && !isSafeMemberPath(memberPath))
+        return "Bhai! '" + memberPath + "' current directory ke bahar likhega; output path alag se do.";
+    string content;
+    if (!readArchiveMember(archivePath, memberPath, content))
+        return "Bhai! Archive '" + archivePath + "' mein '" + memberPath + "' nahi mila (ya data kharab hai).";
+    string target = outputPath.empty() ? memberPath : outputPath;
+    for (size_t slash = target.find('/', 1); slash != string::npos; slash = target.find('/', slash + 1))
+        mkdir(target.substr(0, slash).c_str(), 0755);
+    ofstream file(target, ios::binary);
+    result = file && file.write(content.data(), content.size())
+        ? "Bhai! '" + memberPath + "' nikaal ke '" + target + "' mein rakh diya!"
+        : "Bhai! '" + target + "' mein likh nahi paye!";
+    result += reportPerformance("kholo", "O(member)", "O(member)", start, content.size());
+    return result;
+}
+
+// "padh <archive> <member>": prints one archive member without extracting the rest.
+string padhArchiveCommand(const string &archivePath, const string &memberPath) {
+    auto start = steady_clock::now();
+    string content;
+    string result = readArchiveMember(archivePath, memberPath, content)
+        ? "Bhai! Archive '" + archivePath + "' se '" + memberPath + "' ka content:\n" + content
+        : "Bhai! Archive '" + archivePath + "' mein '" + memberPath + "' nahi mila (ya data kharab hai).";
+    result += reportPerformance("padh (archive member)", "O(member)", "O(member)", start, content.size());
     return result;
 }
+
+// Handlers for the commands whose arguments need more than one call to take apart.
+string padhHandler(const string &arg) {
+    CodecOptions options;
+    string files = parseCodecOptions(arg, options);
+    if (!options.error.empty()) return options.error;
+    size_t separator = files.find(" ");
+    size_t lastSpace = files.rfind(' ');
+    struct stat info;
+    if (!options.fileMode && lastSpace != string::npos && stat(files.c_str(), &info) != 0 &&
+        isArchive(files.substr(0, lastSpace)))
+        return padhArchiveCommand(files.substr(0, lastSpace), trim(files.substr(lastSpace + 1)));
+    if (!options.fileMode) return padhCommand(files, options.threads);
+    return separator != string::npos
+        ? padhFileCommand(files.substr(0, separator), trim(files.substr(separator + 1)), options)
+        : "Bhai! 'padh -f [-j N] <compressed file> <output file>' likho.";
+}
+
+string likhHandler(const string &arg) {
+    CodecOptions options;
+    string files = arg.rfind("-", 0) == 0 ? parseCodecOptions(arg, options) : arg;
+    if (!options.error.empty()) return options.error;
+    size_t separator = files.find(" ");
+    if (options.fileMode)
+        return separator != string::npos
+            ? likhFileCommand(files.substr(0, separator), trim(files.substr(separator + 1)), options)
+            : "Bhai! 'likh -f [-z] [-j N] [-b KB] <input file> <compressed file>' likho.";
+    if (separator == string::npos) return "Bhai! File aur likhne ka content specify karo.";
+    return likhCommand(files.substr(0, separator), files.substr(separator + 1), options);
+}
+
+string dhoondoHandler(const string &arg) {
+    DhoondoOptions options;
+    string error = parseDhoondoOptions(arg, options);
+    if (!error.empty()) return error;
+    if (options.cacheBudgetMB != SIZE_MAX) metadataTable.setPatternCacheBudget(options.cacheBudgetMB << 20);
+    return options.recursive ? dhoondoRecursiveCommand(options) : dhoondoCommand(options);
+}
+
+string baandhoHandler(const string &arg) {
+    CodecOptions options;
+    string dirs = parseCodecOptions(arg, options);
+    if (!options.error.empty()) return options.error;
+    size_t separator = dirs.find(" ");
+    return separator != string::npos
+        ? baandhoCommand(dirs.substr(0, separator), trim(dirs.substr(separator + 1)), options)
+        : "Bhai! 'baandho [-z] [-j N] <directory> <archive>' likho.";
+}
+
+string suchiHandler(const string &arg) {
+    CodecOptions options;
+    options.threads = ThreadPool::defaultThreads();
+    string rest = parseCodecOptions(arg, options);
+    if (!options.error.empty()) return options.error;
+    return rest.empty() ? suchiCommand(options.threads) : "Bhai! 'suchi [-j N]' likho.";
+}
+
+string kholoHandler(const string &arg) {
+    istringstream words(arg);
+    string archivePath, memberPath, outputPath;
+    words >> archivePath >> memberPath >> outputPath;
+    return archivePath.empty() ? "Bhai! 'kholo <archive> [member] [output]' likho."
+                               : kholoCommand(archivePath, memberPath, outputPath);
+}
+
+// khojo [-p N] <name | glob>: page N (from 1) of the matches.
+string khojoHandler(const string &arg) {
+    string rest = trim(arg);
+    size_t page = 1;
+    if (rest.compare(0, 3, "-p ") == 0) {
+        rest = trim(rest.substr(3));
+        size_t end = rest.find(' ');
+        string number = rest.substr(0, end);
+        rest = end == string::npos ? "" : trim(rest.substr(end + 1));
+        bool digits = !number.empty() && all_of(number.begin(), number.end(), ::isdigit);
+        if (digits && !parseNumber(number, page)) return NUMBER_TOO_BIG;
+        if (!digits || page == 0) return "Bhai! '-p' ke baad page number (1 ya zyada) do.";
+    }
+    if (rest.empty()) return "Bhai! 'khojo [-p N] <name | glob>' likho.";
+    return directoryTree.khojo(rest, page);
+}
+
+// jagah [-n N] [directory]: disk usage of the directory (the current one if none) and its
+// N largest entries.
+string jagahHandler(const string &arg) {
+    string rest = trim(arg);
+    size_t top = JAGAH_TOP;
+    if (rest.compare(0, 3, "-n ") == 0) {
+        rest = trim(rest.substr(3));
+        size_t end = rest.find(' ');
+        string number = rest.substr(0, end);
+        rest = end == string::npos ? "" : trim(rest.substr(end + 1));
+        bool digits = !number.empty() && all_of(number.begin(), number.end(), ::isdigit);
+        if (digits && !parseNumber(number, top)) return NUMBER_TOO_BIG;
+        if (!digits || top == 0) return "Bhai! '-n' ke baad ginti (1 ya zyada) do.";
+    }
+    return directoryTree.jagah(rest, top);
+}
+
+// Every BhaiLang command, registered once: adding a command is one line here.
+constexpr auto commandRegistry = makeCommandRegistry<64>({
+    {"banao", REQUIRED_ARGS, "banao <file>", banaoCommand},
+    {"dikhao", NO_ARGS, "dikhao", [](const string &) { return dikhaoCommand(); }},
+    {"mitao", REQUIRED_ARGS, "mitao <file>", mitaoCommand},
+    {"jaane", REQUIRED_ARGS, "jaane <file>", jaaneCommand},
+    {"padh", REQUIRED_ARGS, "padh [-f] [-j N] <file> [output] | padh <archive> <member>", padhHandler},
+    {"likh", REQUIRED_ARGS, "likh [-z] [-b KB] [-j N] <file> <content> | likh -f <input> <output>", likhHandler},
+    {"chalo", REQUIRED_ARGS, "chalo <directory>", [](const string &arg) { return directoryTree.chalo(arg); }},
+    {"wapas", NO_ARGS, "wapas", [](const string &) { return directoryTree.wapas(); }},
+    {"itihas", NO_ARGS, "itihas", [](const string &) { return commandHistory.itihas(); }},
+    {"dhoondo", REQUIRED_ARGS, "dhoondo [-r] [-m MB] [-x | -k N] [-c | -l | -n N] <file> <pattern>", dhoondoHandler},
+    {"khojo", REQUIRED_ARGS, "khojo [-p N] <name | glob>", khojoHandler},
+    {"jagah", OPTIONAL_ARGS, "jagah [-n N] [directory]", jagahHandler},
+    {"banaoDir", REQUIRED_ARGS, "banaoDir <directory>", [](const string &arg) { return directoryTree.banaoDir(arg); }},
+    {"jaha", NO_ARGS, "jaha", [](const string &) { return directoryTree.jaha(); }},
+    {"naapo", OPTIONAL_ARGS, "naapo huffman | codec [file] | search [MB] | scan [dir] | tree [dir]", naapoCommand},
+    {"baandho", REQUIRED_ARGS, "baandho [-z] [-j N] <directory> <archive>", baandhoHandler},
+    {"kholo", REQUIRED_ARGS, "kholo <archive> [member] [output]", kholoHandler},
+    {"suchi", OPTIONAL_ARGS, "suchi [-j N]", suchiHandler},
+    {"bye", NO_ARGS, "bye", [](const string &) -> string { exit(0); }},
+});
+static_assert(commandRegistry.distinctNames(), "Every command needs its own name and a usage line");
+
+// Did-you-mean indexes: every command name, and every earlier input line that ran a
+// known command, so a mistyped line can also be matched against what was typed before.
+BKTree commandNames, historyLines;
+// Last commandHistory entry looked at for historyLines. The tree is only brought up to
+// date when a suggestion is made, so a command that runs pays nothing for it.
+const Node *historyIndexed = nullptr;
+
+void indexHistory() {
+    const Node *line = historyIndexed ? historyIndexed->next : commandHistory.first();
+    for (; line; line = line->next) {
+        historyIndexed = line;
+        if (commandRegistry.find(string_view(line->command).substr(0, line->command.find(' '))))
+            historyLines.insert(line->command);
+    }
+}
+
 string parseBhaiLang(const string &input) {
-    string output;
     size_t spacePos = input.find(" ");
-    string command = input.substr(0, spacePos);
+    string_view command = string_view(input).substr(0, spacePos);
     string arg = (spacePos != string::npos) ? input.substr(spacePos + 1) : "";
 
+    // Whatever changed on disk since the last command shows up in the tree first.
+    directoryTree.syncChanges();
     commandHistory.addCommand(input);
-    metadataTable.incrementCommandCount(command);
+    metadataTable.incrementCommandCount(string(command));
 
-    vector<string> validCommands = {
-        "banao", "dikhao", "mitao", "jaane", "padh", "likh",
-        "chalo", "wapas", "itihas", "dhoondo", "khojo",
-        "banaoDir", "jaha", "bye"
-    };
-
-    if (find(validCommands.begin(), validCommands.end(), command) == validCommands.end()) {
-        string closestMatch = "";
-        int minDistance = INT_MAX;
-        for (const string &validCommand : validCommands) {
-            int distance = levenshteinDistance(command, validCommand);
-            if (distance < minDistance) {
-                minDistance = distance;
-                closestMatch = validCommand;
-            }
-        }
-        return "Bhai! Yeh command nahi samjha: " + command +
-               "\nKya tum '" + closestMatch + "' likhna chahte the?";
+    const CommandSpec *spec = commandRegistry.find(command);
+    if (!spec) {
+        if (commandNames.size() == 0)
+            for (const CommandSpec &candidate : commandRegistry) commandNames.insert(string(candidate.name));
+        string output = "Bhai! Yeh command nahi samjha: " + string(command) + "\nKya tum '" +
+                        *commandNames.closest(command, SIZE_MAX - 1)[0].word + "' likhna chahte the?";
+        indexHistory();
+        auto previous = historyLines.closest(input, max<size_t>(1, input.size() / 4));
+        if (!previous.empty()) output += "\nYa pichhla command: '" + *previous[0].word + "'?";
+        return output;
     }
-
-    if (command == "banao") output = banaoCommand(arg);
-    else if (command == "dikhao") output = dikhaoCommand();
-    else if (command == "mitao") output = mitaoCommand(arg);
-    else if (command == "jaane") output = jaaneCommand(arg);
-    else if (command == "padh") output = padhCommand(arg);
-    else if (command == "likh") {
-        size_t contentPos = arg.find(" ");
-        if (contentPos != string::npos) {
-            string fileName = arg.substr(0, contentPos);
-            string content = arg.substr(contentPos + 1);
-            output = likhCommand(fileName, content);
-        } else output = "Bhai! File aur likhne ka content specify karo.";
-    } else if (command == "dhoondo") {
-        size_t separator = arg.find(" ");
-        if (separator != string::npos) {
-            string fileName = arg.substr(0, separator);
-            string pattern = arg.substr(separator + 1);
-            output = dhoondoCommand(fileName, pattern);
-        } else output = "Bhai! File aur pattern dono specify karo.";
-    } else if (command == "chalo") output = directoryTree.chalo(arg);
-    else if (command == "wapas") output = directoryTree.wapas();
-    else if (command == "itihas") output = commandHistory.itihas();
-    else if (command == "khojo") output = directoryTree.khojo(arg);
-    else if (command == "banaoDir") output = directoryTree.banaoDir(arg);
-    else if (command == "jaha") output = directoryTree.jaha();
-    else if (command == "bye") exit(0);
-
-    return output;
-}
\ No newline at end of file
+    if (spec->args == REQUIRED_ARGS && trim(arg).empty()) return "Bhai! '" + string(spec->usage) + "' likho.";
+    return spec->handler(arg);
+}
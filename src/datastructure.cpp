@@ -7,75 +7,644 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <cstring>
+#include <cerrno>
+#include <sys/inotify.h>
+#include <algorithm>
+#include <tuple>
+#include <fnmatch.h>
+#include <ctime>
+#include <cstdio>
+#include <functional>
+#include <unordered_map>
 
 using namespace std;
 
-DirectoryTree::DirectoryTree() {
+namespace {
+std::string workingDirectory() {
     char cwd[PATH_MAX];
-    if (getcwd(cwd, sizeof(cwd)) != NULL) {
-        root = new TreeNode("/");
-        currentPath = std::string(cwd);
-        current = root;
-        populateTree(root, currentPath);
+    return getcwd(cwd, sizeof(cwd)) != NULL ? std::string(cwd) : "/";
+}
+
+int64_t mtimeNanos(const struct stat& info) {
+    return static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+}
+
+int64_t mtimeOf(const std::string& path) {
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 ? mtimeNanos(info) : 0;
+}
+
+int64_t nowNanos() {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return static_cast<int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+// A directory's mtime only vouches for a listing made at least a second later: an entry
+// added in the same clock tick as the listing would not move it.
+int64_t settledTime(int64_t modified, int64_t listed) {
+    return modified > 0 && modified + 1000000000 < listed ? modified : 0;
+}
+
+// Runs work(begin, end) over [0, count) in batches of STAT_BATCH, spread over a pool when
+// there are several batches and more than one core.
+const size_t STAT_BATCH = 256;
+
+void inBatches(size_t count, const std::function<void(size_t, size_t)>& work) {
+    if (count <= STAT_BATCH || ThreadPool::defaultThreads() == 1) {
+        work(0, count);
+        return;
+    }
+    ThreadPool pool(ThreadPool::defaultThreads());
+    for (size_t begin = 0; begin < count; begin += STAT_BATCH)
+        pool.submit([&work, begin, count]() { work(begin, std::min(begin + STAT_BATCH, count)); });
+    pool.wait();
+}
+
+// One entry on its own, as DiskUsage counts it; something already gone counts as nothing.
+void measureEntry(const std::string& path, DiskUsage& entry) {
+    entry = DiskUsage();
+    entry.known = true;
+    struct stat info;
+    if (lstat(path.c_str(), &info) != 0) return;
+    entry.bytes = static_cast<uint64_t>(info.st_blocks) * 512;
+    entry.files = S_ISDIR(info.st_mode) ? 0 : 1;
+    entry.link = S_ISLNK(info.st_mode);
+}
+
+std::string formatBytes(uint64_t bytes) {
+    const char* units[] = {"B", "KB", "MB", "GB", "TB"};
+    double value = static_cast<double>(bytes);
+    size_t unit = 0;
+    while (value >= 1024 && unit + 1 < sizeof(units) / sizeof(units[0])) {
+        value /= 1024;
+        unit++;
+    }
+    char text[32];
+    snprintf(text, sizeof(text), unit == 0 ? "%.0f %s" : "%.1f %s", value, units[unit]);
+    return text;
+}
+}
+
+// Only the starting directory is listed up front; everything below it stays a stub until
+// a command needs it (see expand), so startup costs one readdir whatever the tree size.
+DirectoryTree::DirectoryTree() : DirectoryTree(workingDirectory(), true) {}
+
+DirectoryTree::DirectoryTree(const std::string& path, bool persistent) : persistent(persistent) {
+    currentPath = path;
+    rootPath = currentPath;
+    root = newNode("/", NO_NODE, true);
+    current = root;
+    if (persistent) {
+        inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        // Only mapped here; it is read as stubs get expanded (see importSnapshot).
+        snapshotPath = treeSnapshotPath(rootPath);
+        if (!snapshotPath.empty()) snapshot.reset(new TreeSnapshot(snapshotPath));
+    }
+    expand(root, rootPath);
+    // A root that still looks as the snapshot has it leaves nothing new to save.
+    if (snapshot && snapshot->isOpen() && (snapshot->flags(TreeSnapshot::ROOT) & SNAPSHOT_LISTED)) {
+        ChildRange listed = children(root);
+        uint32_t first = snapshot->firstChild(TreeSnapshot::ROOT);
+        bool same = snapshot->childCount(TreeSnapshot::ROOT) == listed.size();
+        for (uint32_t i = 0; same && i < listed.size(); i++) {
+            NodeId child = listed.begin()[i];
+            same = snapshot->name(first + i) == nameOf(child) &&
+                   ((snapshot->flags(first + i) & SNAPSHOT_DIRECTORY) != 0) == nodes[child].isDirectory;
+        }
+        snapshotDirty = !same;
+    }
+}
+std::string DirectoryTree::khojo(const std::string& pattern, size_t page) {
+    // The index only knows expanded directories, so the first search lists every stub in
+    // one parallel scan; after that a search reads no directory at all.
+    if (stubs > 0) expandSubtree(root, rootPath);
+    if (refreshUnwatchedBelow(root) && stubs > 0) expandSubtree(root, rootPath);
+
+    bool glob = pattern.find_first_of("*?[") != std::string::npos;
+    std::vector<NodeId> matches = glob ? findMatching(pattern) : findByName(pattern);
+    if (matches.empty()) {
+        std::string suggestion = glob ? "" : suggestName(pattern);
+        return "Bhai! Yeh nahi mila: " + pattern +
+               (suggestion.empty() ? "" : "\nKya tum '" + suggestion + "' dhoondh rahe the?");
+    }
+
+    std::vector<std::string> paths;
+    paths.reserve(matches.size());
+    for (NodeId node : matches) paths.push_back(pathOf(node));
+    if (paths.size() == 1) return "Bhai! Mil gaya: " + paths[0];
+
+    size_t pages = (paths.size() + KHOJO_PAGE_SIZE - 1) / KHOJO_PAGE_SIZE;
+    std::string total = std::to_string(paths.size());
+    if (page > pages) return "Bhai! " + total + " mile, par sirf " + std::to_string(pages) + " page hain.";
+    // Only the pages up to this one need to be in order.
+    size_t first = (page - 1) * KHOJO_PAGE_SIZE, last = std::min(paths.size(), page * KHOJO_PAGE_SIZE);
+    std::partial_sort(paths.begin(), paths.begin() + last, paths.end());
+
+    std::string output = "Bhai! " + total + " mile";
+    if (pages > 1) output += " (page " + std::to_string(page) + "/" + std::to_string(pages) + ")";
+    output += ":\n";
+    for (size_t i = first; i < last; i++) output += "  " + paths[i] + "\n";
+    if (page < pages) output += "Agla page: khojo -p " + std::to_string(page + 1) + " " + pattern;
+    return output;
+}
+
+std::vector<NodeId> DirectoryTree::findByName(string_view name) const {
+    std::vector<NodeId> found;
+    uint32_t id = names.find(name);
+    if (id == StringPool::NOT_FOUND || id >= firstWithName.size()) return found;
+    for (NodeId node = firstWithName[id]; node != NO_NODE; node = nodes[node].nextSameName) found.push_back(node);
+    return found;
+}
+
+std::vector<NodeId> DirectoryTree::findMatching(const std::string& glob) {
+    sortNewNames();
+    string_view prefix = string_view(glob).substr(0, glob.find_first_of("*?[\\"));
+    auto it = std::lower_bound(sortedNames.begin(), sortedNames.end(), prefix, [this](uint32_t id, string_view text) {
+        return names.view(id) < text;
+    });
+    std::vector<NodeId> found;
+    for (; it != sortedNames.end() && names.view(*it).compare(0, prefix.size(), prefix) == 0; ++it) {
+        // Names outlive their nodes in the pool; skip the ones nothing is called any more.
+        if (*it >= firstWithName.size() || firstWithName[*it] == NO_NODE) continue;
+        if (fnmatch(glob.c_str(), names.data(*it), FNM_PERIOD) != 0) continue;
+        for (NodeId node = firstWithName[*it]; node != NO_NODE; node = nodes[node].nextSameName)
+            found.push_back(node);
+    }
+    return found;
+}
+
+void DirectoryTree::sortNewNames() {
+    size_t sorted = sortedNames.size();
+    if (sorted == names.size()) return;
+    for (size_t id = sorted; id < names.size(); id++) sortedNames.push_back(static_cast<uint32_t>(id));
+    auto byName = [this](uint32_t a, uint32_t b) { return strcmp(names.data(a), names.data(b)) < 0; };
+    std::sort(sortedNames.begin() + sorted, sortedNames.end(), byName);
+    std::inplace_merge(sortedNames.begin(), sortedNames.begin() + sorted, sortedNames.end(), byName);
+}
+
+void DirectoryTree::indexNode(NodeId node) {
+    uint32_t name = nodes[node].name;
+    if (firstWithName.size() <= name) firstWithName.resize(names.size(), NO_NODE);
+    NodeId head = firstWithName[name];
+    nodes[node].previousSameName = NO_NODE;
+    nodes[node].nextSameName = head;
+    if (head != NO_NODE) nodes[head].previousSameName = node;
+    firstWithName[name] = node;
+}
+
+void DirectoryTree::unindexNode(NodeId node) {
+    const TreeNode& entry = nodes[node];
+    if (entry.previousSameName != NO_NODE) nodes[entry.previousSameName].nextSameName = entry.nextSameName;
+    else firstWithName[entry.name] = entry.nextSameName;
+    if (entry.nextSameName != NO_NODE) nodes[entry.nextSameName].previousSameName = entry.previousSameName;
+}
+
+bool DirectoryTree::markExpanded(NodeId node) {
+    if (nodes[node].expanded) return false;
+    nodes[node].expanded = true;
+    stubs--;
+    return true;
+}
+
+bool DirectoryTree::listDirectory(const string& path, DirListing& listing) {
+    DIR* dir = opendir(path.c_str());
+    if (dir == NULL) {
+        return false;
+    }
+    struct stat directoryInfo;
+    if (fstat(dirfd(dir), &directoryInfo) == 0) listing.modified = mtimeNanos(directoryInfo);
+    listing.listed = nowNanos();
+
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+        bool isDirectory = entry->d_type == DT_DIR;
+        if (entry->d_type == DT_UNKNOWN || entry->d_type == DT_LNK) {
+            struct stat info;
+            isDirectory = stat((path + "/" + entry->d_name).c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+        }
+        listing.entries.push_back({entry->d_name, isDirectory});
+    }
+    closedir(dir);
+    return true;
+}
+
+NodeId DirectoryTree::newNode(string_view name, NodeId parent, bool isDirectory) {
+    TreeNode node{0, names.intern(name), parent, 0, 0, NO_NODE, NO_NODE, -1, isDirectory, !isDirectory, false};
+    NodeId id;
+    if (!freeNodes.empty()) {
+        id = freeNodes.back();
+        freeNodes.pop_back();
+        nodes[id] = node;
     } else {
-        root = new TreeNode("/");
-        current = root;
-        currentPath = "/";
+        id = static_cast<NodeId>(nodes.size());
+        nodes.push_back(node);
+    }
+    if (!usage.empty()) {
+        usage.resize(nodes.size());
+        usage[id] = DiskUsage();
+    }
+    if (isDirectory) stubs++;
+    if (parent != NO_NODE) indexNode(id);
+    return id;
+}
+
+void DirectoryTree::setChildren(NodeId dir, vector<NodeId>& ids) {
+    std::sort(ids.begin(), ids.end(), [this](NodeId a, NodeId b) {
+        return strcmp(names.data(nodes[a].name), names.data(nodes[b].name)) < 0;
+    });
+    nodes[dir].firstChild = static_cast<uint32_t>(childSlots.size());
+    nodes[dir].childCount = static_cast<uint32_t>(ids.size());
+    childSlots.insert(childSlots.end(), ids.begin(), ids.end());
+}
+
+void DirectoryTree::linkChild(NodeId dir, NodeId child) {
+    if (deadSlots > 4096 && deadSlots * 2 > childSlots.size()) compactSlots();
+    uint32_t first = nodes[dir].firstChild, count = nodes[dir].childCount;
+    if (first + count != childSlots.size()) {
+        // Repeated inserts into one directory then stay at the end and copy nothing.
+        childSlots.reserve(childSlots.size() + count + 1);
+        uint32_t moved = static_cast<uint32_t>(childSlots.size());
+        for (uint32_t i = 0; i < count; i++) childSlots.push_back(childSlots[first + i]);
+        deadSlots += count;
+        first = nodes[dir].firstChild = moved;
     }
+    const char* name = names.data(nodes[child].name);
+    auto begin = childSlots.begin() + first;
+    auto position = std::lower_bound(begin, begin + count, child, [&](NodeId a, NodeId) {
+        return strcmp(names.data(nodes[a].name), name) < 0;
+    });
+    childSlots.insert(position, child);
+    nodes[dir].childCount++;
+    nodes[child].parent = dir;
+    snapshotDirty = true;
+    if (!usage.empty()) usageLinked(dir, child);
 }
-std::string DirectoryTree::khojo(const std::string& target) {
-    std::stack<TreeNode*> stack;
-    stack.push(root);
 
+void DirectoryTree::unlinkChild(NodeId dir, NodeId child) {
+    uint32_t first = nodes[dir].firstChild, count = nodes[dir].childCount;
+    auto begin = childSlots.begin() + first, end = begin + count;
+    const char* name = names.data(nodes[child].name);
+    auto position = std::lower_bound(begin, end, child, [&](NodeId a, NodeId) {
+        return strcmp(names.data(nodes[a].name), name) < 0;
+    });
+    if (position == end || *position != child) return;
+    if (!usage.empty()) usageUnlinked(dir, child);
+    std::copy(position + 1, end, position);
+    if (first + count == childSlots.size()) childSlots.pop_back();
+    else deadSlots++;
+    nodes[dir].childCount--;
+    snapshotDirty = true;
+}
+
+void DirectoryTree::compactSlots() {
+    vector<NodeId> compacted;
+    compacted.reserve(childSlots.size() - deadSlots);
+    for (TreeNode& node : nodes) {
+        uint32_t first = static_cast<uint32_t>(compacted.size());
+        compacted.insert(compacted.end(), childSlots.begin() + node.firstChild,
+                         childSlots.begin() + node.firstChild + node.childCount);
+        node.firstChild = first;
+    }
+    childSlots.swap(compacted);
+    deadSlots = 0;
+}
+
+void DirectoryTree::freeSubtree(NodeId node) {
+    std::stack<NodeId> stack;
+    stack.push(node);
     while (!stack.empty()) {
-        TreeNode* node = stack.top();
+        NodeId next = stack.top();
         stack.pop();
+        for (NodeId child : children(next)) stack.push(child);
+        unindexNode(next);
+        if (!nodes[next].expanded) stubs--;
+        deadSlots += nodes[next].childCount;
+        nodes[next].childCount = 0;
+        nodes[next].parent = NO_NODE;
+        if (next < usage.size()) usage[next] = DiskUsage();
+        freeNodes.push_back(next);
+    }
+}
 
-        // Check if the current node matches the target
-        if (node->name == target) {
-            // Build the full path
-            std::string path;
-            TreeNode* temp = node;
+bool DirectoryTree::isAncestor(NodeId ancestor, NodeId node) const {
+    for (; node != NO_NODE; node = nodes[node].parent)
+        if (node == ancestor) return true;
+    return false;
+}
 
-            while (temp != nullptr && temp != root) {
-                path = "/" + temp->name + path;
-                temp = temp->parent;
-            }
+NodeId DirectoryTree::findChild(NodeId dir, string_view name) const {
+    ChildRange range = children(dir);
+    const NodeId* position = std::lower_bound(range.begin(), range.end(), name, [this](NodeId a, string_view b) {
+        return nameOf(a) < b;
+    });
+    return position != range.end() && nameOf(*position) == name ? *position : NO_NODE;
+}
 
-            // Prepend the current path
-            std::string fullPath = getCurrentPath() + path;
+size_t DirectoryTree::memoryUsage() const {
+    return nodes.capacity() * sizeof(TreeNode) + (childSlots.capacity() + freeNodes.capacity()) * sizeof(NodeId) +
+           usage.capacity() * sizeof(DiskUsage) + names.memoryUsage();
+}
+
+void DirectoryTree::expand(NodeId node) {
+    if (!nodes[node].expanded) expand(node, pathOf(node));
+}
 
-            return "Bhai! Mil gaya: " + fullPath;
+void DirectoryTree::expand(NodeId node, const string& path) {
+    if (!markExpanded(node)) return;
+    expansions++;
+
+    DirListing listing;
+    bool ready = false;
+    {
+        lock_guard<mutex> guard(prefetchLock);
+        auto it = prefetched.find(path);
+        if (it != prefetched.end()) {
+            listing = std::move(it->second);
+            prefetched.erase(it);
+            ready = true;
         }
+    }
+    // A prefetched listing can be several commands old, and the directory is only watched
+    // from here on: it is read again unless its mtime vouches that nothing changed since.
+    if (ready && (mtimeOf(path) != listing.modified || settledTime(listing.modified, listing.listed) == 0)) {
+        listing = DirListing();
+        ready = false;
+    }
+    if (!ready) listDirectory(path, listing);
+    nodes[node].modified = settledTime(listing.modified, listing.listed);
+    snapshotDirty = true;
 
-        // Push all child nodes onto the stack
-        for (const auto& [childName, childNode] : node->children) {
-            stack.push(childNode);
+    vector<NodeId> ids;
+    ids.reserve(listing.entries.size());
+    for (const DirEntry& entry : listing.entries) {
+        ids.push_back(newNode(entry.name, node, entry.isDirectory));
+        if (nameIndexBuilt) nameIndex.insert(entry.name);
+    }
+    setChildren(node, ids);
+    watch(node, path);
+}
+
+void DirectoryTree::expandSubtree(NodeId node, const string& path) {
+    // Stubs can sit anywhere below the directories expanded so far; scan them all at once.
+    vector<NodeId> stubs;
+    vector<string> roots;
+    std::stack<std::pair<NodeId, std::string>> stack;
+    stack.push({node, path});
+    while (!stack.empty()) {
+        auto [next, nextPath] = stack.top();
+        stack.pop();
+        if (!nodes[next].expanded) {
+            stubs.push_back(next);
+            roots.push_back(nextPath);
+            continue;
         }
+        for (NodeId child : children(next))
+            if (nodes[child].isDirectory) stack.push({child, nextPath + "/" + std::string(nameOf(child))});
     }
+    if (stubs.empty()) return;
+    if (snapshot && snapshot->isOpen()) importSnapshot(stubs, roots);
+    if (stubs.empty()) return;
 
-    // If the target is not found
-    return "Bhai! Yeh nahi mila: " + target;
+    ScanStats stats;
+    int64_t started = nowNanos();
+    vector<ScannedEntry> scanned = scanDirectories(roots, ThreadPool::defaultThreads(), stats);
+    for (size_t i = 0; i < stubs.size(); i++) adopt(stubs[i], scanned[i], roots[i], started);
 }
 
-void DirectoryTree::populateTree(TreeNode* node, const string& path) {
-    DIR* dir = opendir(path.c_str());
-    if (dir == NULL) {
-        return;
+void DirectoryTree::adopt(NodeId node, ScannedEntry& scanned, const string& path, int64_t listed) {
+    std::stack<std::tuple<NodeId, ScannedEntry*, std::string>> stack;
+    stack.push({node, &scanned, path});
+    vector<NodeId> ids;
+    while (!stack.empty()) {
+        auto [target, entry, targetPath] = stack.top();
+        stack.pop();
+        if (!markExpanded(target)) continue;
+        expansions++;
+        snapshotDirty = true;
+        nodes[target].cycle = entry->cycle;
+        nodes[target].modified = settledTime(entry->modified, listed);
+        if (!entry->contents) continue;  // unreadable, or a symlink cycle
+        ids.clear();
+        for (ScannedEntry& child : entry->contents->entries) {
+            NodeId childNode = newNode(child.name, target, child.isDirectory);
+            ids.push_back(childNode);
+            if (nameIndexBuilt) nameIndex.insert(child.name);
+            if (child.isDirectory) stack.push({childNode, &child, targetPath + "/" + child.name});
+        }
+        setChildren(target, ids);
+        watch(target, targetPath);
     }
+}
 
-    struct dirent* entry;
-    while ((entry = readdir(dir)) != NULL) {
-        if (string(entry->d_name) == "." || string(entry->d_name) == "..") {
+void DirectoryTree::importSnapshot(vector<NodeId>& stubs, vector<string>& roots) {
+    struct Pending {
+        NodeId node;
+        uint32_t saved;
+        std::string path;
+    };
+    const uint16_t LISTED_DIRECTORY = SNAPSHOT_DIRECTORY | SNAPSHOT_LISTED;
+    std::vector<Pending> pending;
+    std::vector<NodeId> leftStubs;
+    std::vector<std::string> leftRoots;
+    for (size_t i = 0; i < stubs.size(); i++) {
+        uint32_t saved = snapshotNodeOf(stubs[i]);
+        if (saved != TreeSnapshot::NONE && (snapshot->flags(saved) & LISTED_DIRECTORY) == LISTED_DIRECTORY) {
+            pending.push_back({stubs[i], saved, roots[i]});
+        } else {
+            leftStubs.push_back(stubs[i]);
+            leftRoots.push_back(roots[i]);
+        }
+    }
+
+    // Every directory the snapshot has listed below them gets one stat, all in parallel.
+    std::vector<std::pair<uint32_t, std::string>> directories;
+    for (const Pending& start : pending) {
+        std::stack<std::pair<uint32_t, std::string>> walk;
+        walk.push({start.saved, start.path});
+        while (!walk.empty()) {
+            auto [saved, path] = walk.top();
+            walk.pop();
+            directories.push_back({saved, path});
+            uint32_t first = snapshot->firstChild(saved), count = snapshot->childCount(saved);
+            for (uint32_t child = first; child < first + count; child++)
+                if ((snapshot->flags(child) & LISTED_DIRECTORY) == LISTED_DIRECTORY)
+                    walk.push({child, path + "/" + std::string(snapshot->name(child))});
+        }
+    }
+    std::vector<int64_t> current(directories.size(), 0);
+    inBatches(directories.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) current[i] = mtimeOf(directories[i].second);
+    });
+    std::unordered_map<uint32_t, int64_t> mtimes;
+    for (size_t i = 0; i < directories.size(); i++) mtimes[directories[i].first] = current[i];
+
+    std::stack<Pending> work;
+    for (Pending& start : pending) work.push(std::move(start));
+    std::vector<NodeId> ids;
+    while (!work.empty()) {
+        Pending next = std::move(work.top());
+        work.pop();
+        if (!markExpanded(next.node)) continue;
+        expansions++;
+        if (snapshot->flags(next.saved) & SNAPSHOT_CYCLE) {
+            nodes[next.node].cycle = true;
             continue;
         }
+        ids.clear();
+        int64_t modified = snapshot->modified(next.saved);
+        auto known = mtimes.find(next.saved);
+        if (modified != 0 && known != mtimes.end() && known->second == modified) {
+            uint32_t first = snapshot->firstChild(next.saved), count = snapshot->childCount(next.saved);
+            for (uint32_t saved = first; saved < first + count; saved++) {
+                string_view name = snapshot->name(saved);
+                uint16_t flags = snapshot->flags(saved);
+                NodeId child = newNode(name, next.node, flags & SNAPSHOT_DIRECTORY);
+                ids.push_back(child);
+                if (nameIndexBuilt) nameIndex.insert(std::string(name));
+                if (!(flags & SNAPSHOT_DIRECTORY)) continue;
+                std::string childPath = next.path + "/" + std::string(name);
+                if (flags & SNAPSHOT_LISTED) {
+                    work.push({child, saved, childPath});
+                } else {
+                    leftStubs.push_back(child);
+                    leftRoots.push_back(childPath);
+                }
+            }
+            nodes[next.node].modified = modified;
+        } else {
+            // Changed since the snapshot: listed again, while its subdirectories are still
+            // taken from the snapshot where they are unchanged.
+            DirListing listing;
+            listDirectory(next.path, listing);
+            for (const DirEntry& entry : listing.entries) {
+                NodeId child = newNode(entry.name, next.node, entry.isDirectory);
+                ids.push_back(child);
+                if (nameIndexBuilt) nameIndex.insert(entry.name);
+                if (!entry.isDirectory) continue;
+                std::string childPath = next.path + "/" + entry.name;
+                uint32_t saved = snapshot->findChild(next.saved, entry.name);
+                if (saved != TreeSnapshot::NONE && (snapshot->flags(saved) & LISTED_DIRECTORY) == LISTED_DIRECTORY) {
+                    work.push({child, saved, childPath});
+                } else {
+                    leftStubs.push_back(child);
+                    leftRoots.push_back(childPath);
+                }
+            }
+            nodes[next.node].modified = settledTime(listing.modified, listing.listed);
+            snapshotDirty = true;
+        }
+        setChildren(next.node, ids);
+        watch(next.node, next.path);
+    }
+    stubs.swap(leftStubs);
+    roots.swap(leftRoots);
+}
+
+uint32_t DirectoryTree::snapshotNodeOf(NodeId node) const {
+    if (!snapshot || !snapshot->isOpen()) return TreeSnapshot::NONE;
+    std::vector<NodeId> chain;
+    for (; node != root; node = nodes[node].parent) {
+        if (node == NO_NODE) return TreeSnapshot::NONE;
+        chain.push_back(node);
+    }
+    uint32_t saved = TreeSnapshot::ROOT;
+    for (auto it = chain.rbegin(); it != chain.rend() && saved != TreeSnapshot::NONE; ++it)
+        saved = snapshot->findChild(saved, nameOf(*it));
+    return saved;
+}
+
+bool DirectoryTree::saveSnapshot() {
+    if (snapshotPath.empty()) return false;
+    // Breadth first, so each directory's children are written as one run after it.
+    struct Source {
+        NodeId live;     // NO_NODE: copied from the previous snapshot
+        uint32_t saved;
+    };
+    StringPool pool;
+    std::vector<Source> order = {{root, TreeSnapshot::NONE}};
+    std::vector<SnapshotNode> records = {
+        {nodes[root].modified, pool.intern(nameOf(root)), SNAPSHOT_DIRECTORY | SNAPSHOT_LISTED, 0, 0}};
+    for (size_t i = 0; i < order.size(); i++) {
+        Source source = order[i];
+        uint32_t first = static_cast<uint32_t>(order.size());
+        if (source.live == NO_NODE) {
+            uint32_t begin = snapshot->firstChild(source.saved), count = snapshot->childCount(source.saved);
+            for (uint32_t saved = begin; saved < begin + count; saved++) {
+                order.push_back({NO_NODE, saved});
+                records.push_back({snapshot->modified(saved), pool.intern(snapshot->name(saved)),
+                                   snapshot->flags(saved), 0, 0});
+            }
+        } else if (nodes[source.live].isDirectory && nodes[source.live].expanded) {
+            for (NodeId child : children(source.live)) {
+                const TreeNode& entry = nodes[child];
+                uint16_t flags = entry.isDirectory ? SNAPSHOT_DIRECTORY : 0;
+                int64_t modified = entry.modified;
+                uint32_t saved = TreeSnapshot::NONE;
+                if (entry.isDirectory && entry.expanded) {
+                    flags |= entry.cycle ? SNAPSHOT_LISTED | SNAPSHOT_CYCLE : SNAPSHOT_LISTED;
+                } else if (entry.isDirectory) {
+                    // Not listed this session: keep what the previous snapshot knew.
+                    saved = snapshotNodeOf(child);
+                    if (saved != TreeSnapshot::NONE && (snapshot->flags(saved) & SNAPSHOT_LISTED)) {
+                        flags = snapshot->flags(saved);
+                        modified = snapshot->modified(saved);
+                    } else {
+                        saved = TreeSnapshot::NONE;
+                    }
+                }
+                order.push_back({saved == TreeSnapshot::NONE ? child : NO_NODE, saved});
+                records.push_back({modified, pool.intern(nameOf(child)), flags, 0, 0});
+            }
+        }
+        records[i].firstChild = first;
+        records[i].childCount = static_cast<uint32_t>(order.size()) - first;
+    }
+    if (!writeTreeSnapshot(snapshotPath, records, pool)) return false;
+    snapshotDirty = false;
+    return true;
+}
 
-        string childPath = path + "/" + entry->d_name;
-        node->children[entry->d_name] = new TreeNode(entry->d_name, node);
+void DirectoryTree::prefetchChildren(NodeId node, const string& path) {
+    vector<string> pending;
+    for (NodeId child : children(node))
+        if (!nodes[child].expanded) pending.push_back(path + "/" + std::string(nameOf(child)));
+    if (pending.empty()) return;
 
-        populateTree(node->children[entry->d_name], childPath);
+    size_t generation;
+    {
+        lock_guard<mutex> guard(prefetchLock);
+        prefetched.clear();
+        generation = ++prefetchGeneration;
     }
-    closedir(dir);
+    if (!prefetcher) prefetcher.reset(new ThreadPool(1));
+    prefetcher->submit([this, pending, generation]() {
+        for (const string& childPath : pending) {
+            {
+                lock_guard<mutex> guard(prefetchLock);
+                if (generation != prefetchGeneration) return;  // the user has moved on
+            }
+            DirListing listing;
+            if (!listDirectory(childPath, listing)) continue;
+            lock_guard<mutex> guard(prefetchLock);
+            if (generation != prefetchGeneration) return;
+            prefetched[childPath] = std::move(listing);
+        }
+    });
+}
+
+string DirectoryTree::pathOf(NodeId node) {
+    std::vector<NodeId> chain;
+    for (; node != root; node = nodes[node].parent) chain.push_back(node);
+    std::string path = rootPath;
+    for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+        path += '/';
+        path += nameOf(*it);
+    }
+    return path;
 }
 
 std::string DirectoryTree::jaha() {
@@ -87,18 +656,34 @@ std::string DirectoryTree::chalo(const std::string& dirName) {
         return wapas();
     }
 
-    if (current->children.find(dirName) != current->children.end()) {
-        current = current->children[dirName];
+    NodeId next = findChild(current, dirName);
+    if (next != NO_NODE && nodes[next].isDirectory) {
+        current = next;
         currentPath += "/" + dirName;
+        expand(current, currentPath);
+        refreshIfUnwatched(current, currentPath);
+        prefetchChildren(current, currentPath);
         return "Bhai! Tum ab " + getCurrentPath() + " mein ho!";
     } else {
-        return "Bhai! Yeh directory nahi mil rahi: " + dirName;
+        // Only the current directory's entries make sense here, and there are few of them.
+        std::string closest;
+        size_t best = suggestionRadius(dirName.size());
+        for (NodeId child : children(current)) {
+            string_view name = nameOf(child);
+            size_t distance = boundedEditDistance(dirName, name, best);
+            if (distance <= best && (closest.empty() || distance < best)) {
+                closest = std::string(name);
+                best = distance;
+            }
+        }
+        return "Bhai! Yeh directory nahi mil rahi: " + dirName +
+               (closest.empty() ? "" : "\nKya tum '" + closest + "' mein jaana chahte the?");
     }
 }
 
 std::string DirectoryTree::wapas() {
-    if (current->parent != nullptr) {
-        current = current->parent;
+    if (nodes[current].parent != NO_NODE) {
+        current = nodes[current].parent;
 
         size_t pos = currentPath.find_last_of("/");
         currentPath = currentPath.substr(0, pos);
@@ -113,13 +698,17 @@ std::string DirectoryTree::wapas() {
 }
 
 std::string DirectoryTree::dikhao() {
-    if (current->children.empty()) {
+    expand(current, currentPath);
+    refreshIfUnwatched(current, currentPath);
+    if (children(current).empty()) {
         return "Bhai! Yeh directory khaali hai: " + getCurrentPath();
     }
 
     std::string output = "Bhai! Yeh directories aur files hain " + getCurrentPath() + " mein:\n";
-    for (const auto& [name, node] : current->children) {
-        output += "  " + name + "\n";
+    for (NodeId child : children(current)) {
+        output += "  ";
+        output += nameOf(child);
+        output += "\n";
     }
     return output;
 }
@@ -127,24 +716,453 @@ std::string DirectoryTree::dikhao() {
 std::string DirectoryTree::banaoDir(const std::string& dirName) {
     std::string newPath = currentPath + "/" + dirName;
     if (mkdir(newPath.c_str(), 0755) == 0) {
-        current->children[dirName] = new TreeNode(dirName, current);
+        NodeId node = addChild(current, dirName, true, true);
+        watch(node, newPath);
         return "Bhai! Naya directory ban gaya: " + newPath;
     } else {
         return "Bhai! Directory nahi ban paya: " + dirName;
     }
 }
 
+std::vector<std::string> DirectoryTree::subtreePaths(const std::string& dirName) {
+    std::vector<std::string> paths;
+    // Walk down one component at a time; "." and empty components are skipped, ".." is
+    // not followed.
+    NodeId top = current;
+    std::string path = currentPath, relative;
+    for (size_t start = 0; start < dirName.size();) {
+        size_t slash = dirName.find('/', start);
+        if (slash == std::string::npos) slash = dirName.size();
+        std::string part = dirName.substr(start, slash - start);
+        start = slash + 1;
+        if (part.empty() || part == ".") continue;
+        if (part == ".." || !nodes[top].isDirectory) return paths;
+        expand(top, path);
+        top = findChild(top, part);
+        if (top == NO_NODE) return paths;
+        path += "/" + part;
+        relative += (relative.empty() ? "" : "/") + part;
+    }
+    if (top == current) return leafPaths();
+    expandSubtree(top, path);
+    if (refreshUnwatchedBelow(top)) expandSubtree(top, path);
+    collectLeafPaths(top, relative, paths);
+    return paths;
+}
+
+std::vector<std::string> DirectoryTree::leafPaths() {
+    std::vector<std::string> paths;
+    expandSubtree(current, currentPath);
+    if (refreshUnwatchedBelow(current)) expandSubtree(current, currentPath);
+    for (NodeId child : children(current)) collectLeafPaths(child, std::string(nameOf(child)), paths);
+    return paths;
+}
+
+void DirectoryTree::collectLeafPaths(NodeId start, const std::string& startPath, std::vector<std::string>& paths) {
+    std::stack<std::pair<NodeId, std::string>> stack;
+    stack.push({start, startPath});
+    while (!stack.empty()) {
+        auto [node, path] = stack.top();
+        stack.pop();
+        ChildRange range = children(node);
+        if (range.empty()) {
+            paths.push_back(path);
+            continue;
+        }
+        // Reverse push keeps the output in name order.
+        for (const NodeId* child = range.end(); child != range.begin();) {
+            --child;
+            stack.push({*child, path + "/" + std::string(nameOf(*child))});
+        }
+    }
+}
+
 std::string DirectoryTree::getCurrentPath() {
     return currentPath.empty() ? "/" : currentPath;
 }
 
+// The arena goes with its vectors; no per-node teardown.
 DirectoryTree::~DirectoryTree() {
-    deleteTree(root);
+    prefetcher.reset();
+    if (persistent && snapshotDirty) saveSnapshot();
+    if (inotifyFd >= 0) close(inotifyFd);
+}
+
+std::string DirectoryTree::suggestName(const std::string& name) {
+    if (!nameIndexBuilt) {
+        indexNames(root);
+        nameIndexBuilt = true;
+    }
+    // Removed and renamed-away names stay in the BK-tree (it cannot forget a word) and are
+    // skipped here; while they crowd out live ones the search takes more candidates.
+    const size_t WANTED = 8;
+    std::vector<BKTree::Suggestion> suggestions;
+    for (size_t limit = WANTED;; limit *= 2) {
+        auto found = nameIndex.closest(name, suggestionRadius(name.size()), limit);
+        suggestions.clear();
+        for (const BKTree::Suggestion& suggestion : found)
+            if (!findByName(*suggestion.word).empty()) suggestions.push_back(suggestion);
+        if (found.size() < limit || suggestions.size() >= WANTED) break;
+    }
+    if (suggestions.empty() || suggestions[0].distance == 0) return "";
+    // Among the equally close, prefer the same letters in another order (swapped keys),
+    // then the closest length.
+    std::string letters = name;
+    std::sort(letters.begin(), letters.end());
+    auto rank = [&](const BKTree::Suggestion& suggestion) {
+        std::string other = *suggestion.word;
+        std::sort(other.begin(), other.end());
+        size_t lengthGap = other.size() > name.size() ? other.size() - name.size() : name.size() - other.size();
+        return std::make_tuple(suggestion.distance, other != letters, lengthGap);
+    };
+    return *std::min_element(suggestions.begin(), suggestions.end(), [&](const auto& a, const auto& b) {
+        return rank(a) < rank(b);
+    })->word;
+}
+
+void DirectoryTree::indexNames(NodeId node) {
+    for (NodeId child : children(node)) {
+        nameIndex.insert(std::string(nameOf(child)));
+        indexNames(child);
+    }
+}
+
+namespace {
+// IN_CLOSE_WRITE only matters to known disk usage (a file that grew or shrank).
+const uint32_t WATCH_MASK = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE | IN_ONLYDIR;
 }
 
-void DirectoryTree::deleteTree(TreeNode* node) {
-    for (auto& [name, child] : node->children) {
-        deleteTree(child);
+void DirectoryTree::watch(NodeId node, const string& path) {
+    if (inotifyFd < 0 || nodes[node].watch >= 0) return;
+    int wd = inotify_add_watch(inotifyFd, path.c_str(), WATCH_MASK);
+    if (wd < 0) {
+        // Out of watches (fs.inotify.max_user_watches): re-listed when used instead.
+        if (errno == ENOSPC) unwatched.insert(node);
+        return;
     }
-    delete node;
+    unwatched.erase(node);
+    nodes[node].watch = wd;
+    watched[wd].push_back(node);
+}
+
+void DirectoryTree::unwatch(NodeId node) {
+    std::stack<NodeId> stack;
+    stack.push(node);
+    while (!stack.empty()) {
+        NodeId next = stack.top();
+        stack.pop();
+        unwatched.erase(next);
+        int wd = nodes[next].watch;
+        if (wd >= 0) {
+            auto it = watched.find(wd);
+            if (it != watched.end()) {
+                it->second.erase(std::remove(it->second.begin(), it->second.end(), next), it->second.end());
+                if (it->second.empty()) {
+                    inotify_rm_watch(inotifyFd, wd);
+                    watched.erase(it);
+                }
+            }
+            nodes[next].watch = -1;
+        }
+        for (NodeId child : children(next)) stack.push(child);
+    }
+}
+
+NodeId DirectoryTree::addChild(NodeId parent, const string& name, bool isDirectory, bool isNew) {
+    NodeId existing = findChild(parent, name);
+    if (existing != NO_NODE) {
+        if (nodes[existing].isDirectory == isDirectory) return existing;
+        removeNode(existing);  // replaced by something of the other kind
+    }
+    NodeId node = newNode(name, parent, isDirectory);
+    if (isNew && isDirectory) markExpanded(node);  // nothing to list
+    linkChild(parent, node);
+    if (nameIndexBuilt) nameIndex.insert(name);
+    return node;
+}
+
+void DirectoryTree::detach(NodeId node) {
+    if (isAncestor(node, current)) current = nodes[node].parent;
+    unlinkChild(nodes[node].parent, node);
+}
+
+void DirectoryTree::removeNode(NodeId node) {
+    if (node == root) return;
+    detach(node);
+    unwatch(node);
+    freeSubtree(node);
+}
+
+void DirectoryTree::resync(NodeId node, const string& path, bool recursive) {
+    if (!nodes[node].expanded) return;
+    DirListing listing;
+    listDirectory(path, listing);  // a directory that is gone comes back empty
+    nodes[node].modified = settledTime(listing.modified, listing.listed);
+    std::map<std::string, bool> listed;
+    for (const DirEntry& entry : listing.entries) listed[entry.name] = entry.isDirectory;
+
+    std::vector<NodeId> stale;
+    for (NodeId child : children(node)) {
+        auto it = listed.find(std::string(nameOf(child)));
+        if (it == listed.end() || it->second != nodes[child].isDirectory) stale.push_back(child);
+    }
+    for (NodeId child : stale) removeNode(child);
+    for (const auto& [name, isDirectory] : listed) addChild(node, name, isDirectory);
+    watch(node, path);
+
+    if (!recursive) return;
+    std::vector<NodeId> subdirectories;
+    for (NodeId child : children(node))
+        if (nodes[child].isDirectory && nodes[child].expanded) subdirectories.push_back(child);
+    for (NodeId child : subdirectories) resync(child, path + "/" + std::string(nameOf(child)), true);
+}
+
+void DirectoryTree::refreshIfUnwatched(NodeId node, const string& path) {
+    if (unwatched.count(node)) resync(node, path, false);
+}
+
+bool DirectoryTree::refreshUnwatchedBelow(NodeId top) {
+    // Snapshot first: a resync can delete (and unregister) other unwatched nodes.
+    std::vector<NodeId> pending;
+    for (NodeId node : unwatched)
+        if (isAncestor(top, node)) pending.push_back(node);
+    for (NodeId node : pending)
+        if (unwatched.count(node)) resync(node, pathOf(node), false);
+    return !pending.empty();
+}
+
+void DirectoryTree::syncChanges() {
+    if (inotifyFd < 0) return;
+    alignas(struct inotify_event) char buffer[1 << 16];
+    // A rename inside the tree comes as IN_MOVED_FROM then IN_MOVED_TO with one cookie:
+    // the subtree is parked in between so it moves with its expansion and watches intact.
+    std::map<uint32_t, NodeId> movedAway;
+    bool overflow = false;
+    ssize_t length;
+    while ((length = read(inotifyFd, buffer, sizeof(buffer))) > 0) {
+        for (char* p = buffer; p < buffer + length;) {
+            auto* event = reinterpret_cast<struct inotify_event*>(p);
+            p += sizeof(struct inotify_event) + event->len;
+            if (event->mask & IN_Q_OVERFLOW) {
+                overflow = true;
+                continue;
+            }
+            auto it = watched.find(event->wd);
+            if (it == watched.end()) continue;
+            if (event->mask & IN_IGNORED) {
+                for (NodeId node : it->second) nodes[node].watch = -1;
+                watched.erase(it);
+                continue;
+            }
+            if (event->len == 0) continue;
+            std::string name = event->name;
+            bool isDirectory = event->mask & IN_ISDIR;
+            for (NodeId parent : std::vector<NodeId>(it->second)) {
+                if (nodes[parent].watch != event->wd) continue;  // removed by an earlier one
+                NodeId child = findChild(parent, name);
+                if (event->mask & IN_MOVED_FROM) {
+                    if (child == NO_NODE) continue;
+                    if (event->cookie && !movedAway.count(event->cookie)) {
+                        detach(child);
+                        movedAway[event->cookie] = child;
+                    } else {
+                        removeNode(child);
+                    }
+                } else if (event->mask & IN_DELETE) {
+                    if (child != NO_NODE) removeNode(child);
+                } else if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                    auto moved = movedAway.find(event->cookie);
+                    if ((event->mask & IN_MOVED_TO) && event->cookie && moved != movedAway.end()) {
+                        NodeId node = moved->second;
+                        movedAway.erase(moved);
+                        if (child != NO_NODE) removeNode(child);
+                        unindexNode(node);
+                        nodes[node].name = names.intern(name);
+                        indexNode(node);
+                        linkChild(parent, node);
+                        if (nameIndexBuilt) nameIndex.insert(name);
+                    } else {
+                        addChild(parent, name, isDirectory);
+                    }
+                } else if (event->mask & IN_CLOSE_WRITE) {
+                    if (child != NO_NODE) usageChanged(child);
+                }
+            }
+        }
+    }
+    // Moved out of the tree (or out of watched directories): gone as far as we can tell.
+    // detach() has already moved current out of them.
+    for (const auto& [cookie, node] : movedAway) {
+        unwatch(node);
+        freeSubtree(node);
+    }
+    if (overflow) resync(root, rootPath, true);
+    currentPath = pathOf(current);  // a rename above it changes it
+    refreshIfUnwatched(current, currentPath);
+}
+
+NodeId DirectoryTree::parentOf(const string& path, string& name) {
+    std::string relative = path;
+    if (!path.empty() && path[0] == '/') {
+        std::string prefix = rootPath == "/" ? "/" : rootPath + "/";
+        if (path.compare(0, prefix.size(), prefix) != 0) return NO_NODE;
+        relative = path.substr(prefix.size());
+    }
+    std::vector<std::string> parts;
+    size_t start = 0;
+    while (start <= relative.size()) {
+        size_t slash = relative.find('/', start);
+        std::string part = relative.substr(start, slash == std::string::npos ? std::string::npos : slash - start);
+        if (part == "..") {
+            if (parts.empty()) return NO_NODE;
+            parts.pop_back();
+        } else if (!part.empty() && part != ".") {
+            parts.push_back(part);
+        }
+        if (slash == std::string::npos) break;
+        start = slash + 1;
+    }
+    if (parts.empty()) return NO_NODE;
+    name = parts.back();
+    NodeId node = root;
+    for (size_t i = 0; i + 1 < parts.size(); i++) {
+        node = findChild(node, parts[i]);
+        if (node == NO_NODE) return NO_NODE;
+    }
+    return nodes[node].isDirectory && nodes[node].expanded ? node : NO_NODE;
+}
+
+void DirectoryTree::noteCreated(const string& path, bool isDirectory) {
+    std::string name;
+    NodeId parent = parentOf(path, name);
+    if (parent == NO_NODE) return;
+    NodeId node = addChild(parent, name, isDirectory, true);
+    if (isDirectory && nodes[node].expanded) watch(node, pathOf(node));
+}
+
+void DirectoryTree::noteRemoved(const string& path) {
+    std::string name;
+    NodeId parent = parentOf(path, name);
+    if (parent == NO_NODE) return;
+    NodeId node = findChild(parent, name);
+    if (node != NO_NODE) removeNode(node);
+    currentPath = pathOf(current);
+}
+
+std::string DirectoryTree::jagah(const std::string& dirName, size_t top) {
+    expand(current, currentPath);
+    NodeId node = current;
+    std::string path = getCurrentPath();
+    if (!dirName.empty()) {
+        node = findChild(current, dirName);
+        if (node == NO_NODE) return "Bhai! Yeh nahi mila: " + dirName + " (" + getCurrentPath() + " mein)";
+        path = currentPath + "/" + dirName;
+    }
+    size_t measured = measureUsage(node, path);
+
+    DiskUsage total = usage[node];
+    if (total.link && nodes[node].isDirectory) {
+        // Asked about a symlinked directory (or standing in one): what it points at.
+        total.bytes = total.files = 0;
+        for (NodeId child : children(node)) {
+            total.bytes += usage[child].bytes;
+            total.files += usage[child].files;
+        }
+    }
+    ChildRange range = children(node);
+    std::vector<NodeId> largest(range.begin(), range.end());
+    size_t shown = std::min(top, largest.size());
+    std::partial_sort(largest.begin(), largest.begin() + shown, largest.end(), [this](NodeId a, NodeId b) {
+        if (usage[a].bytes != usage[b].bytes) return usage[a].bytes > usage[b].bytes;
+        return nameOf(a) < nameOf(b);
+    });
+
+    std::string output = "Bhai! " + path + ": " + formatBytes(total.bytes) + ", " + std::to_string(total.files) +
+                         " files" + (shown ? ", sabse bade:\n" : "\n");
+    for (size_t i = 0; i < shown; i++) {
+        const DiskUsage& entry = usage[largest[i]];
+        char line[64];
+        snprintf(line, sizeof(line), "  %10s %9llu files  ", formatBytes(entry.bytes).c_str(),
+                 static_cast<unsigned long long>(entry.files));
+        output += line;
+        output += nameOf(largest[i]);
+        output += nodes[largest[i]].isDirectory && !entry.link ? "/\n" : "\n";
+    }
+    if (largest.size() > shown) output += "  ... aur " + std::to_string(largest.size() - shown) + " entries\n";
+    output += "Naye naape: " + std::to_string(measured) + " entries, baaki cache se.";
+    return output;
+}
+
+size_t DirectoryTree::measureUsage(NodeId top, const string& path) {
+    expandSubtree(top, path);
+    if (refreshUnwatchedBelow(top)) expandSubtree(top, path);
+    usage.resize(nodes.size());
+
+    // What is not known yet, parents before their children. Nodes below a link are measured
+    // too: the link does not count them, but they may be asked about on their own.
+    std::vector<std::pair<NodeId, std::string>> pending;
+    std::stack<std::pair<NodeId, std::string>> walk;
+    walk.push({top, path});
+    while (!walk.empty()) {
+        auto [node, nodePath] = walk.top();
+        walk.pop();
+        if (usage[node].known && !(node == top && usage[node].link)) continue;
+        for (NodeId child : children(node)) walk.push({child, nodePath + "/" + std::string(nameOf(child))});
+        pending.push_back({node, nodePath});
+    }
+    std::vector<DiskUsage> measured(pending.size());
+    inBatches(pending.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) measureEntry(pending[i].second, measured[i]);
+    });
+    // Children first, so every directory adds up totals that are already complete.
+    for (size_t i = pending.size(); i-- > 0;) {
+        NodeId node = pending[i].first;
+        DiskUsage entry = measured[i];
+        if (!entry.link) {
+            for (NodeId child : children(node)) {
+                entry.bytes += usage[child].bytes;
+                entry.files += usage[child].files;
+            }
+        }
+        usage[node] = entry;
+    }
+    return pending.size();
+}
+
+void DirectoryTree::usageLinked(NodeId dir, NodeId child) {
+    if (!usage[dir].known || usage[dir].link) return;
+    if (!usage[child].known) {
+        if (nodes[child].isDirectory && (!nodes[child].expanded || nodes[child].childCount > 0)) {
+            forgetUsage(dir);
+            return;
+        }
+        measureEntry(pathOf(child), usage[child]);
+    }
+    for (NodeId up = dir; up != NO_NODE && usage[up].known && !usage[up].link; up = nodes[up].parent) {
+        usage[up].bytes += usage[child].bytes;
+        usage[up].files += usage[child].files;
+    }
+}
+
+void DirectoryTree::usageUnlinked(NodeId dir, NodeId child) {
+    if (!usage[dir].known || usage[dir].link) return;
+    for (NodeId up = dir; up != NO_NODE && usage[up].known && !usage[up].link; up = nodes[up].parent) {
+        usage[up].bytes -= usage[child].bytes;
+        usage[up].files -= usage[child].files;
+    }
+}
+
+void DirectoryTree::usageChanged(NodeId file) {
+    if (file >= usage.size() || !usage[file].known || usage[file].link || nodes[file].isDirectory) return;
+    DiskUsage before = usage[file];
+    measureEntry(pathOf(file), usage[file]);
+    for (NodeId up = nodes[file].parent; up != NO_NODE && usage[up].known && !usage[up].link; up = nodes[up].parent) {
+        usage[up].bytes = usage[up].bytes - before.bytes + usage[file].bytes;
+        usage[up].files = usage[up].files - before.files + usage[file].files;
+    }
+}
+
+void DirectoryTree::forgetUsage(NodeId node) {
+    for (; node != NO_NODE && usage[node].known && !usage[node].link; node = nodes[node].parent)
+        usage[node].known = false;
 }
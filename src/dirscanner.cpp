@@ -0,0 +1,131 @@
+#include "dirscanner.h"
+#include "threadpool.h"
+#include <atomic>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+// Record layout returned by getdents64 (glibc has no wrapper on older versions).
+struct LinuxDirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+// A directory fd shared by the tasks of its subdirectories; closed once the last of them
+// has opened its own. Tasks run newest-first, so only the fds along the current paths of
+// the walk stay open.
+struct DirFd {
+    int fd;
+    explicit DirFd(int fd) : fd(fd) {}
+    ~DirFd() { close(fd); }
+};
+
+// The directories from the scan root down to one being scanned, as an immutable list
+// shared between siblings.
+struct Ancestor {
+    dev_t device;
+    ino_t inode;
+    shared_ptr<const Ancestor> parent;
+};
+
+class Scan {
+public:
+    explicit Scan(size_t threads) : pool(threads) {}
+
+    void start(ScannedEntry& root) { visit(nullptr, root, nullptr); }
+    void finish(ScanStats& stats) {
+        pool.wait();
+        stats.directories += directories;
+        stats.entries += entries;
+        stats.statCalls += statCalls;
+        stats.batches += batches;
+        stats.cycles += cycles;
+        stats.unreadable += unreadable;
+    }
+
+private:
+    ThreadPool pool;
+    atomic<size_t> directories{0}, entries{0}, statCalls{0}, batches{0}, cycles{0}, unreadable{0};
+
+    // Opens one directory (below parent, or entry.name itself for a root), lists it into
+    // entry.contents and queues its subdirectories.
+    void visit(shared_ptr<DirFd> parent, ScannedEntry& entry, shared_ptr<const Ancestor> ancestors) {
+        int fd = openat(parent ? parent->fd : AT_FDCWD, entry.name.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        parent.reset();
+        struct stat info;
+        if (fd < 0 || fstat(fd, &info) != 0) {
+            if (fd >= 0) close(fd);
+            unreadable++;
+            return;
+        }
+        for (const Ancestor* a = ancestors.get(); a; a = a->parent.get()) {
+            if (a->device == info.st_dev && a->inode == info.st_ino) {
+                close(fd);
+                entry.cycle = true;
+                cycles++;
+                return;
+            }
+        }
+        entry.modified = static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+        auto self = make_shared<DirFd>(fd);
+        auto chain = make_shared<const Ancestor>(Ancestor{info.st_dev, info.st_ino, ancestors});
+        entry.contents.reset(new ScannedDirectory());
+        vector<ScannedEntry>& children = entry.contents->entries;
+
+        thread_local char buffer[SCAN_BUFFER_SIZE];
+        size_t localStats = 0, localBatches = 0;
+        while (true) {
+            long bytes = syscall(SYS_getdents64, fd, buffer, sizeof(buffer));
+            if (bytes <= 0) break;
+            localBatches++;
+            for (long offset = 0; offset < bytes;) {
+                auto* record = reinterpret_cast<LinuxDirent64*>(buffer + offset);
+                offset += record->d_reclen;
+                const char* name = record->d_name;
+                if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) continue;
+                ScannedEntry child;
+                child.name = name;
+                child.isDirectory = record->d_type == DT_DIR;
+                if (record->d_type == DT_LNK || record->d_type == DT_UNKNOWN) {
+                    struct stat target;
+                    child.isDirectory = fstatat(fd, name, &target, 0) == 0 && S_ISDIR(target.st_mode);
+                    localStats++;
+                }
+                children.push_back(std::move(child));
+            }
+        }
+        directories++;
+        entries += children.size();
+        statCalls += localStats;
+        batches += localBatches;
+
+        // children is complete and never resized again, so the tasks can hold references.
+        for (ScannedEntry& child : children)
+            if (child.isDirectory) pool.submit([this, self, &child, chain]() { visit(self, child, chain); });
+    }
+};
+
+}  // namespace
+
+vector<ScannedEntry> scanDirectories(const vector<string>& roots, size_t threads, ScanStats& stats) {
+    vector<ScannedEntry> result(roots.size());
+    Scan scan(max<size_t>(1, threads));
+    for (size_t i = 0; i < roots.size(); i++) {
+        result[i].name = roots[i];
+        result[i].isDirectory = true;
+    }
+    // Roots are opened by path from the calling thread; everything below goes to the pool.
+    for (ScannedEntry& root : result) scan.start(root);
+    scan.finish(stats);
+    return result;
+}
@@ -0,0 +1,144 @@
+#include "fuzzy.h"
+#include <algorithm>
+
+using namespace std;
+
+FuzzyMatcher::FuzzyMatcher(const string& pattern, size_t maxErrors)
+    : pattern(pattern), maxErrors(maxErrors), blocks((pattern.size() + 63) / 64) {
+    peq.assign(256 * blocks, 0);
+    for (size_t i = 0; i < pattern.size(); i++)
+        peq[static_cast<unsigned char>(pattern[i]) * blocks + i / 64] |= uint64_t(1) << (i % 64);
+    lastHigh = uint64_t(1) << ((pattern.size() - 1) % 64);
+}
+
+namespace {
+
+// One block of Myers' column update. pv/mv are the vertical +1/-1 deltas, eq the
+// pattern-equality bits for the text byte, hin the horizontal delta entering the block's
+// top row (-1, 0, +1). Returns the delta leaving its bottom row, read at `high`.
+inline int advanceBlock(uint64_t& pv, uint64_t& mv, uint64_t eq, int hin, uint64_t high) {
+    uint64_t xv = eq | mv;
+    if (hin < 0) eq |= 1;
+    uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+    uint64_t ph = mv | ~(xh | pv);
+    uint64_t mh = pv & xh;
+    int hout = (ph & high) ? 1 : (mh & high) ? -1 : 0;
+    ph <<= 1;
+    mh <<= 1;
+    if (hin < 0) mh |= 1;
+    else if (hin > 0) ph |= 1;
+    pv = mh | ~(xv | ph);
+    mv = ph & xv;
+    return hout;
+}
+
+}  // namespace
+
+bool FuzzyMatcher::nextMatch(const char* text, size_t size, size_t from, size_t& start, size_t& end,
+                             size_t& distance) const {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(text);
+    const size_t m = pattern.size();
+    const long k = static_cast<long>(maxErrors);
+    const size_t last = blocks - 1;
+    vector<uint64_t> pv(blocks), mv(blocks);
+    vector<long> score(blocks);  // edit distance at each block's bottom row
+    size_t y = 0;                // last active block
+
+    // A fresh column: the matrix restarts at every line start, so matches stay in one line.
+    auto reset = [&]() {
+        y = min(last, maxErrors ? (maxErrors - 1) / 64 : size_t(0));
+        for (size_t b = 0; b <= y; b++) {
+            pv[b] = ~uint64_t(0);
+            mv[b] = 0;
+            score[b] = static_cast<long>(min((b + 1) * 64, m));
+        }
+    };
+    reset();
+
+    size_t lineStart = from;
+    bool found = false;
+    long best = 0;
+    size_t bestEnd = 0;
+    for (size_t i = from; i < size; i++) {
+        unsigned char c = p[i];
+        if (c == '\n') {
+            if (found) break;
+            reset();
+            lineStart = i + 1;
+            continue;
+        }
+        const uint64_t* eq = &peq[c * blocks];
+        if (blocks == 1) {
+            // Common case, kept free of the block bookkeeping below.
+            score[0] += advanceBlock(pv[0], mv[0], eq[0], 0, lastHigh);
+            if (score[0] <= k) {
+                if (!found || score[0] < best) {
+                    found = true;
+                    best = score[0];
+                    bestEnd = i + 1;
+                }
+                if (best == 0) break;
+            } else if (found) {
+                break;
+            }
+            continue;
+        }
+        int carry = 0;
+        for (size_t b = 0; b <= y; b++) {
+            carry = advanceBlock(pv[b], mv[b], eq[b], carry, b == last ? lastHigh : uint64_t(1) << 63);
+            score[b] += carry;
+        }
+        // Ukkonen's cutoff: wake the next block when the current bottom row can still reach
+        // it within k errors, drop trailing blocks whose every row is above k.
+        if (y < last && score[y] - carry <= k && ((eq[y + 1] & 1) || carry < 0)) {
+            y++;
+            pv[y] = ~uint64_t(0);
+            mv[y] = 0;
+            score[y] = score[y - 1] + static_cast<long>(min((y + 1) * 64, m) - y * 64) - carry;
+            score[y] += advanceBlock(pv[y], mv[y], eq[y], carry, y == last ? lastHigh : uint64_t(1) << 63);
+        } else {
+            while (y > 0 && score[y] >= k + 64) y--;
+        }
+
+        if (y == last && score[y] <= k) {
+            if (!found || score[y] < best) {
+                found = true;
+                best = score[y];
+                bestEnd = i + 1;
+            }
+            if (best == 0) break;
+        } else if (found) {
+            break;
+        }
+    }
+    if (!found) return false;
+
+    end = bestEnd;
+    distance = static_cast<size_t>(best);
+    size_t span = m + distance;
+    start = findStart(p, max(lineStart, end > span ? end - span : size_t(0)), end, distance);
+    return true;
+}
+
+size_t FuzzyMatcher::findStart(const unsigned char* text, size_t lo, size_t end, size_t distance) const {
+    // Plain DP, right to left from `end`: column[i] is the distance between the last i
+    // pattern bytes and the text read so far. Runs once per reported match over at most
+    // m + distance bytes.
+    const size_t m = pattern.size();
+    vector<size_t> column(m + 1);
+    for (size_t i = 0; i <= m; i++) column[i] = i;
+    size_t start = end;
+    for (size_t j = 1; j <= end - lo; j++) {
+        unsigned char t = text[end - j];
+        size_t diagonal = column[0];
+        column[0] = j;
+        for (size_t i = 1; i <= m; i++) {
+            size_t above = column[i];
+            size_t substitute = diagonal + (static_cast<unsigned char>(pattern[m - i]) != t);
+            column[i] = min(substitute, min(above, column[i - 1]) + 1);
+            diagonal = above;
+        }
+        if (column[m] <= distance) start = end - j;
+    }
+    return start;
+}
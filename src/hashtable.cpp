@@ -1,4 +1,6 @@
 #include "hashtable.h"
+#include "search.h"
+#include "mappedfile.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -7,10 +9,11 @@
 
 using namespace std;
 
-HashTable::HashTable(size_t size) : tableSize(size) {
+HashTable::HashTable(size_t size, size_t cacheBudget)
+    : tableSize(size), cacheBudget(cacheBudget), cacheBytes(0), cacheHits(0), cacheMisses(0), cacheEvictions(0) {
     commandTable.resize(size);
     metadataTable.resize(size);
-    patternOccurrences.resize(size);  
+    patternCache.resize(size);
 }
 
 HashTable::~HashTable() {}
@@ -81,42 +84,97 @@ void HashTable::removeFileMetadata(const string& key) {
 }
 
 
-vector<pair<int, int>> HashTable::searchPattern(const string& fileName, const string& pattern) {
-    vector<pair<int, int>> occurrences;  // To store line numbers and positions
+bool HashTable::stampFile(const string& fileName, FileStamp& stamp) {
+    struct stat info;
+    if (stat(fileName.c_str(), &info) != 0) return false;
+    stamp.size = info.st_size;
+    stamp.mtime = static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+    return true;
+}
 
-    ifstream file(fileName);
-    if (!file.is_open()) {
-        cerr << "Bhai! File '" << fileName << "' nahi khul rahi!" << endl;
-        return occurrences;
-    }
 
-    string line;
-    int lineNumber = 0;
-     while (getline(file, line)) {
-         lineNumber++;
-        size_t pos = line.find(pattern);
-        while (pos != string::npos) {
-            occurrences.emplace_back(lineNumber, pos);  
-            pos = line.find(pattern, pos + 1);         
-        }
+const HashTable::PatternResult* HashTable::findPatternResult(const string& fileName, const string& pattern,
+                                                             const FileStamp& stamp) {
+    string key = fileName + '\0' + pattern;
+    for (auto& pair : patternCache[hashFunction(key)]) {
+        if (pair.first != key) continue;
+        if (!(pair.second.stamp == stamp)) break;  // file changed since the scan
+        cacheHits++;
+        lruKeys.splice(lruKeys.begin(), lruKeys, pair.second.lru);
+        return &pair.second.result;
     }
+    erasePatternResult(key);
+    cacheMisses++;
+    return nullptr;
+}
 
-    file.close();
 
-    
-    size_t index = hashFunction ( fileName + pattern);
-      patternOccurrences[index].emplace_back(fileName + pattern, occurrences);
+void HashTable::storePatternResult(const string& fileName, const string& pattern, const FileStamp& stamp,
+                                   const PatternResult& result) {
+    string key = fileName + '\0' + pattern;
+    erasePatternResult(key);
+    // Rough footprint: key (stored twice), occurrences, counts and the node overheads.
+    size_t bytes = 2 * key.size() + result.occurrences.size() * sizeof(result.occurrences[0]) +
+                   result.perPattern.size() * sizeof(size_t) + sizeof(CacheEntry) + 64;
+    if (bytes > cacheBudget) return;
 
-      return occurrences;
+    lruKeys.push_front(key);
+    patternCache[hashFunction(key)].emplace_back(key, CacheEntry{stamp, result, bytes, lruKeys.begin()});
+    cacheBytes += bytes;
+    setPatternCacheBudget(cacheBudget);
 }
 
 
-vector<pair<int, int>>* HashTable::getPatternOccurrences(const string& fileName, const string& pattern) {
-    size_t index = hashFunction(fileName + pattern);
-    for (auto& pair : patternOccurrences[index]) {
-        if (pair.first == fileName + pattern) {
-            return &pair.second;
+void HashTable::setPatternCacheBudget(size_t bytes) {
+    cacheBudget = bytes;
+    while (cacheBytes > cacheBudget && !lruKeys.empty()) {
+        erasePatternResult(lruKeys.back());
+        cacheEvictions++;
+    }
+}
+
+
+void HashTable::erasePatternResult(const string& key) {
+    auto& bucket = patternCache[hashFunction(key)];
+    for (auto it = bucket.begin(); it != bucket.end(); ++it) {
+        if (it->first == key) {
+            cacheBytes -= it->second.bytes;
+            lruKeys.erase(it->second.lru);
+            bucket.erase(it);
+            return;
         }
     }
-    return nullptr;
+}
+
+
+vector<pair<int, int>> HashTable::searchPattern(const string& fileName, const string& pattern) {
+    vector<pair<int, int>> occurrences;  // To store line numbers and positions
+
+    FileStamp stamp;
+    const PatternResult* cached = stampFile(fileName, stamp) ? findPatternResult(fileName, pattern, stamp) : nullptr;
+    PatternResult scanned;
+    if (!cached) {
+        MappedFile file(fileName);
+        if (!file.isOpen()) {
+            cerr << "Bhai! File '" << fileName << "' nahi khul rahi!" << endl;
+            return occurrences;
+        }
+        LineLocator locator(file.data(), file.size());
+        size_t line, column, lastLine = 0;
+        for (size_t pos = searchFirst(file.data(), file.size(), pattern.data(), pattern.size()); pos != SEARCH_NPOS;
+             pos = searchFirst(file.data(), file.size(), pattern.data(), pattern.size(), pos + 1)) {
+            locator.locate(pos, line, column);
+            if (line != lastLine) scanned.matchedLines++;
+            lastLine = line;
+            scanned.occurrences.emplace_back(line, column, 0);
+        }
+        scanned.perPattern.assign(1, scanned.occurrences.size());
+        scanned.newlines = locator.totalNewlines();
+        scanned.lines = scanned.newlines + (file.size() > 0 && file.data()[file.size() - 1] != '\n' ? 1 : 0);
+        storePatternResult(fileName, pattern, stamp, scanned);
+        cached = &scanned;
+    }
+
+    for (const auto& [line, column, index] : cached->occurrences) occurrences.emplace_back(line, column);
+    return occurrences;
 }
@@ -1,40 +1,124 @@
 #include "huffman.h"
 #include <sstream>
+#include <algorithm>
+#include <vector>
+#include <climits>
+#include <cstring>
+#include <fstream>
+#include <atomic>
+#include <cstdio>
+#include <unistd.h>
+#include "threadpool.h"
 
-struct Node {
-    char ch;
-    int freq;
-    Node *left, *right;
-    Node(char c, int f) : ch(c), freq(f), left(nullptr), right(nullptr) {}
-    Node(Node* l, Node* r) : ch('\0'), freq(l->freq + r->freq), left(l), right(r) {}
-};
+// Byte histogram. Four count tables are updated round-robin so runs of the same byte
+// do not serialize on one counter's load/store chain; 32-bit lanes are folded into the
+// 64-bit totals every 1 GB so they cannot overflow.
+void countBytes(const char* data, size_t size, uint64_t freq[256]) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+    const size_t flushEvery = size_t(1) << 30;
+    while (size > 0) {
+        uint32_t lanes[4][256] = {{0}};
+        size_t n = std::min(size, flushEvery);
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            uint64_t word;
+            std::memcpy(&word, p + i, 8);
+            lanes[0][word & 0xFF]++;
+            lanes[1][(word >> 8) & 0xFF]++;
+            lanes[2][(word >> 16) & 0xFF]++;
+            lanes[3][(word >> 24) & 0xFF]++;
+            lanes[0][(word >> 32) & 0xFF]++;
+            lanes[1][(word >> 40) & 0xFF]++;
+            lanes[2][(word >> 48) & 0xFF]++;
+            lanes[3][word >> 56]++;
+        }
+        for (; i < n; i++) lanes[0][p[i]]++;
+        for (int s = 0; s < 256; s++)
+            freq[s] += uint64_t(lanes[0][s]) + lanes[1][s] + lanes[2][s] + lanes[3][s];
+        p += n;
+        size -= n;
+    }
+}
 
-struct Compare {
-    bool operator()(Node* a, Node* b) { return a->freq > b->freq; }
-};
+// Huffman code lengths without heap allocation: leaves are sorted once, then merged with
+// the two-queue method (leaves and internal nodes are both consumed in ascending weight
+// order), with all nodes living in fixed-size arrays indexed by position.
+static int huffmanDepths(const uint64_t* weights, const int* symbols, int count, uint8_t* lengths) {
+    uint64_t weight[2 * HUFFMAN_MAX_SYMBOLS];
+    int parent[2 * HUFFMAN_MAX_SYMBOLS];
+    int order[HUFFMAN_MAX_SYMBOLS];
+    for (int i = 0; i < count; i++) order[i] = i;
+    std::sort(order, order + count, [&](int a, int b) {
+        return weights[a] != weights[b] ? weights[a] < weights[b] : symbols[a] < symbols[b];
+    });
+    for (int i = 0; i < count; i++) weight[i] = weights[order[i]];
 
-void buildCodeMap(Node* root, const std::string& str, std::unordered_map<char, std::string>& codeMap) {
-    if (!root) return;
-    if (!root->left && !root->right) codeMap[root->ch] = str;
-    buildCodeMap(root->left, str + "0", codeMap);
-    buildCodeMap(root->right, str + "1", codeMap);
+    int nextLeaf = 0, nextInternal = count, created = count;
+    auto takeSmallest = [&]() {
+        if (nextLeaf < count && (nextInternal == created || weight[nextLeaf] <= weight[nextInternal]))
+            return nextLeaf++;
+        return nextInternal++;
+    };
+    while (created < 2 * count - 1) {
+        int a = takeSmallest();
+        int b = takeSmallest();
+        weight[created] = weight[a] + weight[b];
+        parent[a] = parent[b] = created;
+        created++;
+    }
+
+    // Parents are always created after their children, so one backward sweep sets depths.
+    int depth[2 * HUFFMAN_MAX_SYMBOLS];
+    int root = created - 1, maxDepth = 0;
+    depth[root] = 0;
+    for (int i = root - 1; i >= 0; i--) depth[i] = depth[parent[i]] + 1;
+    for (int i = 0; i < count; i++) {
+        lengths[symbols[order[i]]] = static_cast<uint8_t>(depth[i]);
+        maxDepth = std::max(maxDepth, depth[i]);
+    }
+    return maxDepth;
 }
 
+// Code lengths for a histogram, limited to HUFFMAN_MAX_CODE_LENGTH bits.
+// If the optimal tree is too deep, frequencies are halved (keeping them non-zero) and
+// the tree is rebuilt; this flattens the skew that produced the long codes.
+void buildCodeLengths(const uint64_t* freq, int symbolCount, uint8_t* lengths) {
+    uint64_t weights[HUFFMAN_MAX_SYMBOLS];
+    int symbols[HUFFMAN_MAX_SYMBOLS];
+    int count = 0;
+    std::fill(lengths, lengths + symbolCount, 0);
+    for (int s = 0; s < symbolCount; s++) {
+        if (!freq[s]) continue;
+        weights[count] = freq[s];
+        symbols[count++] = s;
+    }
+    if (count == 0) return;
+    if (count == 1) {
+        lengths[symbols[0]] = 1;
+        return;
+    }
+    while (huffmanDepths(weights, symbols, count, lengths) > HUFFMAN_MAX_CODE_LENGTH)
+        for (int i = 0; i < count; i++) weights[i] = (weights[i] >> 1) | 1;
+}
+
+// Legacy text-format code map, derived from canonical lengths; each code string is built once.
 std::unordered_map<char, std::string> buildHuffmanCode(const std::string& text) {
-    std::unordered_map<char, int> freq;
-    for (char c : text) freq[c]++;
+    uint64_t freq[256] = {0};
+    countBytes(text.data(), text.size(), freq);
 
-    std::priority_queue<Node*, std::vector<Node*>, Compare> pq;
-    for (auto& [ch, f] : freq) pq.push(new Node(ch, f));
-
-    while (pq.size() > 1) {
-        Node* left = pq.top(); pq.pop();
-        Node* right = pq.top(); pq.pop();
-        pq.push(new Node(left, right));
-    }
+    uint8_t lengths[256];
+    uint32_t codes[256];
+    buildCodeLengths(freq, 256, lengths);
+    assignCanonicalCodes(lengths, 256, codes);
 
     std::unordered_map<char, std::string> codeMap;
-    buildCodeMap(pq.top(), "", codeMap);
+    for (int s = 0; s < 256; s++) {
+        if (!lengths[s]) continue;
+        std::string& code = codeMap[static_cast<char>(s)];
+        code.resize(lengths[s]);
+        for (int bit = 0; bit < lengths[s]; bit++)
+            code[bit] = ((codes[s] >> (lengths[s] - 1 - bit)) & 1) ? '1' : '0';
+    }
     return codeMap;
 }
 
@@ -80,3 +164,744 @@ std::unordered_map<char, std::string> deserializeCodeMap(const std::string& str)
     }
     return map;
 }
+
+// Canonical codes: shorter codes first, ties broken by symbol value (RFC 1951, 3.2.2).
+void assignCanonicalCodes(const uint8_t* lengths, int symbolCount, uint32_t* codes) {
+    uint32_t lengthCount[HUFFMAN_MAX_CODE_LENGTH + 1] = {0};
+    for (int s = 0; s < symbolCount; s++) lengthCount[lengths[s]]++;
+    lengthCount[0] = 0;
+
+    uint32_t nextCode[HUFFMAN_MAX_CODE_LENGTH + 2] = {0};
+    uint32_t code = 0;
+    for (int len = 1; len <= HUFFMAN_MAX_CODE_LENGTH; len++) {
+        code = (code + lengthCount[len - 1]) << 1;
+        nextCode[len] = code;
+    }
+    for (int s = 0; s < symbolCount; s++)
+        codes[s] = lengths[s] ? nextCode[lengths[s]]++ : 0;
+}
+
+static void putLE(std::string& out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) out += static_cast<char>((value >> (8 * i)) & 0xFF);
+}
+
+static uint64_t getLE(const unsigned char* in, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++) value |= static_cast<uint64_t>(in[i]) << (8 * i);
+    return value;
+}
+
+static uint64_t getLE(const std::string& in, size_t pos, int bytes) {
+    return getLE(reinterpret_cast<const unsigned char*>(in.data()) + pos, bytes);
+}
+
+bool isHuffmanContainer(const std::string& data) {
+    return data.size() >= HUFFMAN_HEADER_SIZE && data.compare(0, 4, "BHUF") == 0;
+}
+
+static int trimmedTableSize(const uint8_t lengths[256]) {
+    int tableSize = 256;
+    while (tableSize > 0 && lengths[tableSize - 1] == 0) tableSize--;
+    return tableSize;
+}
+
+static void writeLengthTable(std::string& out, const uint8_t lengths[256], int tableSize) {
+    for (int s = 0; s < tableSize; s += 2)
+        out += static_cast<char>(lengths[s] << 4 | (s + 1 < tableSize ? lengths[s + 1] : 0));
+}
+
+static void readLengthTable(const unsigned char* in, size_t tableSize, uint8_t lengths[256]) {
+    for (size_t s = 0; s < tableSize; s++)
+        lengths[s] = (s % 2 == 0) ? in[s / 2] >> 4 : in[s / 2] & 0x0F;
+}
+
+static void writeContainerHeader(std::string& out, uint8_t version, int tableSize, uint64_t originalLength,
+                                 uint8_t codec = HUFFMAN_CODEC_ORDER0) {
+    out += "BHUF";
+    out += static_cast<char>(version);
+    out += static_cast<char>(codec);
+    putLE(out, tableSize, 2);
+    putLE(out, originalLength, 8);
+}
+
+// Parses a version 1 header and code-length table; headerBytes is where the payload starts.
+static bool readContainerHeader(const std::string& data, uint64_t& originalLength,
+                                uint8_t lengths[256], size_t& tableSize, size_t& headerBytes) {
+    if (!isHuffmanContainer(data)) return false;
+    if (static_cast<uint8_t>(data[4]) != HUFFMAN_CONTAINER_VERSION) return false;
+    if (static_cast<uint8_t>(data[5]) != HUFFMAN_CODEC_ORDER0) return false;
+
+    tableSize = getLE(data, 6, 2);
+    originalLength = getLE(data, 8, 8);
+    size_t tableBytes = (tableSize + 1) / 2;
+    if (tableSize > 256 || data.size() < HUFFMAN_HEADER_SIZE + tableBytes) return false;
+
+    readLengthTable(reinterpret_cast<const unsigned char*>(data.data()) + HUFFMAN_HEADER_SIZE, tableSize, lengths);
+    headerBytes = HUFFMAN_HEADER_SIZE + tableBytes;
+    return true;
+}
+
+static void encodeBytes(const char* data, size_t size, const uint8_t lengths[256],
+                        const uint32_t codes[256], BitWriter& writer) {
+    for (size_t i = 0; i < size; i++) {
+        unsigned char s = static_cast<unsigned char>(data[i]);
+        writer.write(codes[s], lengths[s]);
+    }
+}
+
+std::string compressHuffman(const std::string& text) {
+    uint64_t freq[256] = {0};
+    countBytes(text.data(), text.size(), freq);
+
+    uint8_t lengths[256];
+    uint32_t codes[256];
+    buildCodeLengths(freq, 256, lengths);
+    assignCanonicalCodes(lengths, 256, codes);
+
+    std::string out;
+    uint64_t payloadBits = 0;
+    for (int s = 0; s < 256; s++) payloadBits += freq[s] * lengths[s];
+    out.reserve(HUFFMAN_HEADER_SIZE + 128 + (payloadBits + 7) / 8);
+
+    int tableSize = trimmedTableSize(lengths);
+    writeContainerHeader(out, HUFFMAN_CONTAINER_VERSION, tableSize, text.size());
+    writeLengthTable(out, lengths, tableSize);
+    BitWriter writer(out);
+    encodeBytes(text.data(), text.size(), lengths, codes, writer);
+    writer.flush();
+    return out;
+}
+
+bool HuffmanDecoder::init(const uint8_t* lengths, int symbolCount) {
+    uint32_t codes[HUFFMAN_MAX_SYMBOLS];
+    if (symbolCount > HUFFMAN_MAX_SYMBOLS) return false;
+
+    int maxLen = 1;
+    uint64_t kraft = 0;
+    for (int s = 0; s < symbolCount; s++) {
+        if (lengths[s] > HUFFMAN_MAX_CODE_LENGTH) return false;
+        if (lengths[s]) {
+            maxLen = std::max<int>(maxLen, lengths[s]);
+            kraft += uint64_t(1) << (HUFFMAN_MAX_CODE_LENGTH - lengths[s]);
+        }
+    }
+    if (kraft > (uint64_t(1) << HUFFMAN_MAX_CODE_LENGTH)) return false;
+
+    assignCanonicalCodes(lengths, symbolCount, codes);
+    tableBits = maxLen;
+    table.assign(size_t(1) << maxLen, 0);
+    for (int s = 0; s < symbolCount; s++) {
+        int len = lengths[s];
+        if (!len) continue;
+        // A code of length len owns every table slot that starts with it.
+        uint32_t first = codes[s] << (maxLen - len);
+        uint32_t count = uint32_t(1) << (maxLen - len);
+        uint32_t entry = static_cast<uint32_t>(s + 1) << 8 | static_cast<uint32_t>(len);
+        std::fill(table.begin() + first, table.begin() + first + count, entry);
+    }
+    return true;
+}
+
+// Decodes up to `count` symbols into out, refilling once per batch. One refill leaves
+// >= 56 bits, enough for four 12-bit codes. Returns the number of symbols decoded,
+// which is short only if an invalid code was hit.
+static uint64_t decodeSymbols(const HuffmanDecoder& decoder, BitReader& reader, char* out, uint64_t count) {
+    const int perRefill = 56 / decoder.maxLength();
+    uint64_t i = 0;
+    while (i < count) {
+        reader.refill();
+        uint64_t batchEnd = std::min<uint64_t>(count, i + perRefill);
+        for (; i < batchEnd; i++) {
+            int symbol = decoder.decode(reader);
+            if (symbol < 0) return i;
+            out[i] = static_cast<char>(symbol);
+        }
+    }
+    return i;
+}
+
+bool decompressHuffman(const std::string& data, std::string& output, size_t threads) {
+    if (isHuffmanContainer(data) && static_cast<uint8_t>(data[4]) == HUFFMAN_BLOCKED_VERSION)
+        return decompressHuffmanBlocks(data, output, threads);
+
+    uint64_t originalLength;
+    uint8_t lengths[256];
+    size_t tableSize, headerBytes;
+    if (!readContainerHeader(data, originalLength, lengths, tableSize, headerBytes)) return false;
+
+    HuffmanDecoder decoder;
+    if (!decoder.init(lengths, static_cast<int>(tableSize))) return false;
+
+    const unsigned char* payload = reinterpret_cast<const unsigned char*>(data.data()) + headerBytes;
+    size_t payloadSize = data.size() - headerBytes;
+    // Every symbol costs at least one bit.
+    if (originalLength > payloadSize * 8) return false;
+
+    output.resize(originalLength);
+    BitReader reader(payload, payloadSize);
+    if (decodeSymbols(decoder, reader, &output[0], originalLength) != originalLength) return false;
+    return !reader.overrun();
+}
+
+static void writeOrder0Body(const char* data, size_t size, std::string& out) {
+    uint64_t freq[256] = {0};
+    countBytes(data, size, freq);
+
+    uint8_t lengths[256];
+    uint32_t codes[256];
+    buildCodeLengths(freq, 256, lengths);
+    assignCanonicalCodes(lengths, 256, codes);
+
+    uint64_t payloadBits = 0;
+    for (int s = 0; s < 256; s++) payloadBits += freq[s] * lengths[s];
+    out.reserve(out.size() + 130 + (payloadBits + 7) / 8);
+
+    int tableSize = trimmedTableSize(lengths);
+    putLE(out, tableSize, 2);
+    writeLengthTable(out, lengths, tableSize);
+    BitWriter writer(out);
+    encodeBytes(data, size, lengths, codes, writer);
+    writer.flush();
+}
+
+static bool readOrder0Body(const unsigned char* data, size_t size, char* out, uint64_t rawLength) {
+    if (size < 2) return false;
+    size_t tableSize = getLE(data, 2);
+    size_t tableBytes = (tableSize + 1) / 2;
+    if (tableSize > 256 || size < 2 + tableBytes) return false;
+
+    uint8_t lengths[256];
+    readLengthTable(data + 2, tableSize, lengths);
+    HuffmanDecoder decoder;
+    if (!decoder.init(lengths, static_cast<int>(tableSize))) return false;
+
+    size_t payloadSize = size - 2 - tableBytes;
+    if (rawLength > payloadSize * 8) return false;
+    BitReader reader(data + 2 + tableBytes, payloadSize);
+    return decodeSymbols(decoder, reader, out, rawLength) == rawLength && !reader.overrun();
+}
+
+// LZ77 codec. Matches come from a hash-chain finder over a 32 KB window; literals and
+// match lengths share one Huffman alphabet and distances get a second one, using the
+// RFC 1951 length/distance code tables (base value + extra bits).
+namespace {
+
+const int LZ_WINDOW = 1 << 15;
+const int LZ_MIN_MATCH = 3;
+const int LZ_MAX_MATCH = 258;
+const int LZ_HASH_BITS = 15;
+const int LZ_MAX_CHAIN = 48;
+const int LZ_LAZY_LIMIT = 32;  // matches at least this long are taken without a lazy check
+const int LZ_LITLEN_SYMBOLS = 286;
+const int LZ_DIST_SYMBOLS = 30;
+
+const uint16_t lengthBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+const uint8_t lengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+const uint16_t distBase[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385,
+                               513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+const uint8_t distExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7,
+                               8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+// Token: a literal byte, or MATCH_FLAG | length << 16 | distance.
+const uint32_t MATCH_FLAG = 0x80000000u;
+
+int lengthCode(int length) {
+    int code = 28;
+    while (lengthBase[code] > length) code--;
+    return code;
+}
+
+int distCode(int distance) {
+    int code = 29;
+    while (distBase[code] > distance) code--;
+    return code;
+}
+
+uint32_t hash3(const unsigned char* p) {
+    return ((uint32_t(p[0]) << 16 | uint32_t(p[1]) << 8 | p[2]) * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+// Greedy parse with one step of lazy evaluation: a match is deferred when the next
+// position starts a longer one.
+void findMatches(const unsigned char* data, size_t size, std::vector<uint32_t>& tokens) {
+    std::vector<int32_t> head(size_t(1) << LZ_HASH_BITS, -1);
+    std::vector<int32_t> prev(LZ_WINDOW, -1);
+    tokens.reserve(size / 2);
+
+    auto insert = [&](size_t pos) {
+        if (pos + LZ_MIN_MATCH > size) return;
+        uint32_t h = hash3(data + pos);
+        prev[pos & (LZ_WINDOW - 1)] = head[h];
+        head[h] = static_cast<int32_t>(pos);
+    };
+    auto longestMatch = [&](size_t pos, int& bestDistance) {
+        int best = 0;
+        if (pos + LZ_MIN_MATCH > size) return best;
+        int maxLength = static_cast<int>(std::min<size_t>(LZ_MAX_MATCH, size - pos));
+        int32_t candidate = head[hash3(data + pos)];
+        for (int chain = 0; candidate >= 0 && chain < LZ_MAX_CHAIN; chain++) {
+            size_t distance = pos - candidate;
+            if (distance == 0 || distance > LZ_WINDOW) break;
+            const unsigned char* a = data + candidate;
+            const unsigned char* b = data + pos;
+            if (a[best] == b[best]) {
+                int length = 0;
+                // Eight bytes per step; the first differing byte is the lowest set byte of the XOR.
+                while (length + 8 <= maxLength) {
+                    uint64_t x, y;
+                    std::memcpy(&x, a + length, 8);
+                    std::memcpy(&y, b + length, 8);
+                    if (x != y) {
+                        length += __builtin_ctzll(x ^ y) >> 3;
+                        break;
+                    }
+                    length += 8;
+                }
+                if (length + 8 > maxLength)
+                    while (length < maxLength && a[length] == b[length]) length++;
+                if (length > best) {
+                    best = length;
+                    bestDistance = static_cast<int>(distance);
+                    if (length == maxLength) break;
+                }
+            }
+            int32_t next = prev[candidate & (LZ_WINDOW - 1)];
+            if (next >= candidate) break;
+            candidate = next;
+        }
+        return best >= LZ_MIN_MATCH ? best : 0;
+    };
+
+    size_t pos = 0;
+    while (pos < size) {
+        int distance = 0;
+        int length = longestMatch(pos, distance);
+        if (length) {
+            insert(pos);
+            int nextDistance = 0;
+            if (length < LZ_LAZY_LIMIT && longestMatch(pos + 1, nextDistance) > length) {
+                tokens.push_back(data[pos]);
+                pos++;
+                continue;
+            }
+            tokens.push_back(MATCH_FLAG | uint32_t(length) << 16 | uint32_t(distance));
+            for (size_t i = pos + 1; i < pos + length; i++) insert(i);
+            pos += length;
+        } else {
+            insert(pos);
+            tokens.push_back(data[pos]);
+            pos++;
+        }
+    }
+}
+
+void writeLz77Body(const char* data, size_t size, std::string& out) {
+    std::vector<uint32_t> tokens;
+    findMatches(reinterpret_cast<const unsigned char*>(data), size, tokens);
+
+    uint64_t litLenFreq[LZ_LITLEN_SYMBOLS] = {0};
+    uint64_t distFreq[LZ_DIST_SYMBOLS] = {0};
+    for (uint32_t token : tokens) {
+        if (!(token & MATCH_FLAG)) {
+            litLenFreq[token]++;
+            continue;
+        }
+        litLenFreq[257 + lengthCode((token >> 16) & 0x1FF)]++;
+        distFreq[distCode(token & 0xFFFF)]++;
+    }
+
+    uint8_t litLenLengths[LZ_LITLEN_SYMBOLS], distLengths[LZ_DIST_SYMBOLS];
+    uint32_t litLenCodes[LZ_LITLEN_SYMBOLS], distCodes[LZ_DIST_SYMBOLS];
+    buildCodeLengths(litLenFreq, LZ_LITLEN_SYMBOLS, litLenLengths);
+    buildCodeLengths(distFreq, LZ_DIST_SYMBOLS, distLengths);
+    assignCanonicalCodes(litLenLengths, LZ_LITLEN_SYMBOLS, litLenCodes);
+    assignCanonicalCodes(distLengths, LZ_DIST_SYMBOLS, distCodes);
+
+    // Both tables are stored in full (4 bits per symbol, 143 + 15 bytes).
+    putLE(out, tokens.size(), 4);
+    for (int s = 0; s < LZ_LITLEN_SYMBOLS; s += 2)
+        out += static_cast<char>(litLenLengths[s] << 4 | litLenLengths[s + 1]);
+    for (int s = 0; s < LZ_DIST_SYMBOLS; s += 2)
+        out += static_cast<char>(distLengths[s] << 4 | distLengths[s + 1]);
+
+    BitWriter writer(out);
+    for (uint32_t token : tokens) {
+        if (!(token & MATCH_FLAG)) {
+            writer.write(litLenCodes[token], litLenLengths[token]);
+            continue;
+        }
+        int length = (token >> 16) & 0x1FF, distance = token & 0xFFFF;
+        int lc = lengthCode(length), dc = distCode(distance);
+        writer.write(litLenCodes[257 + lc], litLenLengths[257 + lc]);
+        if (lengthExtra[lc]) writer.write(length - lengthBase[lc], lengthExtra[lc]);
+        writer.write(distCodes[dc], distLengths[dc]);
+        if (distExtra[dc]) writer.write(distance - distBase[dc], distExtra[dc]);
+    }
+    writer.flush();
+}
+
+bool readLz77Body(const unsigned char* data, size_t size, char* out, uint64_t rawLength) {
+    const size_t tableBytes = LZ_LITLEN_SYMBOLS / 2 + LZ_DIST_SYMBOLS / 2;
+    if (size < 4 + tableBytes) return false;
+    uint64_t tokenCount = getLE(data, 4);
+
+    uint8_t litLenLengths[LZ_LITLEN_SYMBOLS], distLengths[LZ_DIST_SYMBOLS];
+    readLengthTable(data + 4, LZ_LITLEN_SYMBOLS, litLenLengths);
+    readLengthTable(data + 4 + LZ_LITLEN_SYMBOLS / 2, LZ_DIST_SYMBOLS, distLengths);
+    HuffmanDecoder litLen, dist;
+    if (!litLen.init(litLenLengths, LZ_LITLEN_SYMBOLS) || !dist.init(distLengths, LZ_DIST_SYMBOLS)) return false;
+
+    BitReader reader(data + 4 + tableBytes, size - 4 - tableBytes);
+    if (tokenCount > reader.bitsRemaining()) return false;
+    uint64_t produced = 0;
+    for (uint64_t t = 0; t < tokenCount; t++) {
+        // One refill covers the longest token: 12 + 5 + 12 + 13 bits.
+        reader.refill();
+        int symbol = litLen.decode(reader);
+        if (symbol < 0 || symbol == 256) return false;
+        if (symbol < 256) {
+            if (produced >= rawLength) return false;
+            out[produced++] = static_cast<char>(symbol);
+            continue;
+        }
+        int lc = symbol - 257;
+        int length = lengthBase[lc];
+        if (lengthExtra[lc]) {
+            length += reader.peek(lengthExtra[lc]);
+            reader.consume(lengthExtra[lc]);
+        }
+        int dc = dist.decode(reader);
+        if (dc < 0) return false;
+        uint64_t distance = distBase[dc];
+        if (distExtra[dc]) {
+            distance += reader.peek(distExtra[dc]);
+            reader.consume(distExtra[dc]);
+        }
+        if (distance > produced || static_cast<uint64_t>(length) > rawLength - produced) return false;
+        // Byte-wise copy: the source may overlap the bytes being written.
+        char* dst = out + produced;
+        const char* src = dst - distance;
+        for (int i = 0; i < length; i++) dst[i] = src[i];
+        produced += length;
+    }
+    return produced == rawLength && !reader.overrun();
+}
+
+}  // namespace
+
+// Appends one self-contained block: raw length u32 | encoded length u32 | codec body.
+// The encoded length covers the body. An order-0 body is table size u16 | code lengths |
+// payload; an LZ77 body is token count u32 | both code-length tables | payload.
+void compressHuffmanBlock(const char* data, size_t size, std::string& out, uint8_t codec) {
+    putLE(out, size, 4);
+    size_t encodedLengthPos = out.size();
+    putLE(out, 0, 4);
+    if (codec == HUFFMAN_CODEC_LZ77) writeLz77Body(data, size, out);
+    else writeOrder0Body(data, size, out);
+
+    uint64_t encodedLength = out.size() - encodedLengthPos - 4;
+    for (int i = 0; i < 4; i++) out[encodedLengthPos + i] = static_cast<char>((encodedLength >> (8 * i)) & 0xFF);
+}
+
+// Decodes the body of one block (everything after its 8-byte length prefix).
+bool decompressHuffmanBlock(const unsigned char* data, size_t size, char* out, uint64_t rawLength, uint8_t codec) {
+    if (codec == HUFFMAN_CODEC_LZ77) return readLz77Body(data, size, out, rawLength);
+    if (codec == HUFFMAN_CODEC_ORDER0) return readOrder0Body(data, size, out, rawLength);
+    return false;
+}
+
+static bool isKnownCodec(uint8_t codec) {
+    return codec == HUFFMAN_CODEC_ORDER0 || codec == HUFFMAN_CODEC_LZ77;
+}
+
+// Most bytes `encodedLength` bytes of block bodies can decode to: every symbol costs at
+// least one bit, and an LZ77 symbol stands for at most LZ_MAX_MATCH bytes.
+static uint64_t maxDecodedLength(uint8_t codec, uint64_t encodedLength) {
+    return encodedLength * 8 * (codec == HUFFMAN_CODEC_LZ77 ? LZ_MAX_MATCH : 1);
+}
+
+uint8_t huffmanContainerCodec(const std::string& data) {
+    return isHuffmanContainer(data) ? static_cast<uint8_t>(data[5]) : HUFFMAN_CODEC_ORDER0;
+}
+
+const char* huffmanCodecName(uint8_t codec) {
+    return codec == HUFFMAN_CODEC_LZ77 ? "LZ77 + Huffman" : "Huffman";
+}
+
+std::string compressHuffmanBlocks(const std::string& text, size_t blockSize, size_t threads, uint8_t codec) {
+    size_t blockCount = blockSize ? (text.size() + blockSize - 1) / blockSize : 0;
+    std::vector<std::string> blocks(blockCount);
+    ThreadPool pool(std::min({threads, ThreadPool::maxThreads(), std::max<size_t>(blockCount, 1)}));
+    for (size_t b = 0; b < blockCount; b++)
+        pool.submit([&, b] {
+            size_t begin = b * blockSize;
+            compressHuffmanBlock(text.data() + begin, std::min(blockSize, text.size() - begin), blocks[b], codec);
+        });
+    pool.wait();
+
+    std::string out;
+    writeContainerHeader(out, HUFFMAN_BLOCKED_VERSION, 0, text.size(), codec);
+    putLE(out, blockSize, 4);
+    for (auto& block : blocks) out += block;
+    return out;
+}
+
+bool decompressHuffmanBlocks(const std::string& data, std::string& output, size_t threads) {
+    if (!isHuffmanContainer(data) || data.size() < HUFFMAN_BLOCKED_HEADER_SIZE) return false;
+    if (static_cast<uint8_t>(data[4]) != HUFFMAN_BLOCKED_VERSION) return false;
+    uint8_t codec = static_cast<uint8_t>(data[5]);
+    if (!isKnownCodec(codec)) return false;
+    uint64_t originalLength = getLE(data, 8, 8);
+    uint64_t blockSize = getLE(data, 16, 4);
+    // Every length is checked against the header and the payload before anything is
+    // allocated, so a corrupt block table fails here rather than in output.resize().
+    if (originalLength > maxDecodedLength(codec, data.size() - HUFFMAN_BLOCKED_HEADER_SIZE)) return false;
+
+    // Walk the length prefixes first so every block knows its input and output offsets.
+    struct BlockRef { size_t offset, size; uint64_t outOffset, rawLength; };
+    std::vector<BlockRef> refs;
+    size_t pos = HUFFMAN_BLOCKED_HEADER_SIZE;
+    uint64_t outOffset = 0;
+    while (pos < data.size()) {
+        if (data.size() - pos < HUFFMAN_BLOCK_HEADER_SIZE) return false;
+        uint64_t rawLength = getLE(data, pos, 4);
+        uint64_t encodedLength = getLE(data, pos + 4, 4);
+        if (encodedLength > data.size() - pos - HUFFMAN_BLOCK_HEADER_SIZE) return false;
+        if (rawLength > blockSize || rawLength > originalLength - outOffset ||
+            rawLength > maxDecodedLength(codec, encodedLength))
+            return false;
+        refs.push_back({pos + HUFFMAN_BLOCK_HEADER_SIZE, static_cast<size_t>(encodedLength), outOffset, rawLength});
+        outOffset += rawLength;
+        pos += HUFFMAN_BLOCK_HEADER_SIZE + encodedLength;
+    }
+    if (outOffset != originalLength) return false;
+
+    output.resize(originalLength);
+    std::atomic<bool> ok(true);
+    ThreadPool pool(std::min({threads, ThreadPool::maxThreads(), std::max<size_t>(refs.size(), 1)}));
+    const unsigned char* base = reinterpret_cast<const unsigned char*>(data.data());
+    for (const auto& ref : refs)
+        pool.submit([&, ref] {
+            if (!decompressHuffmanBlock(base + ref.offset, ref.size, &output[0] + ref.outOffset, ref.rawLength, codec))
+                ok = false;
+        });
+    pool.wait();
+    return ok;
+}
+
+// The file variants write "<output>.<pid>.tmp" beside the output and rename it over the
+// output only once it is complete: the input may be the output itself (or a link to it),
+// and truncating the output up front would wipe the input before it was read.
+static std::string tempOutputPath(const std::string& outputPath) {
+    return outputPath + "." + std::to_string(getpid()) + ".tmp";
+}
+
+// Closes the temporary and renames it over the output if everything went through;
+// otherwise removes it and leaves any existing output alone.
+static bool finishOutput(std::ofstream& out, bool ok, const std::string& tempPath,
+                         const std::string& outputPath) {
+    out.close();
+    if (ok && !out.fail() && std::rename(tempPath.c_str(), outputPath.c_str()) == 0) return true;
+    std::remove(tempPath.c_str());
+    return false;
+}
+
+static bool compressToStream(std::ifstream& in, std::ofstream& out, uint64_t& originalBytes,
+                             uint64_t& compressedBytes, size_t threads, size_t blockSize, uint8_t codec) {
+    if (blockSize == 0 || blockSize > UINT32_MAX) blockSize = HUFFMAN_DEFAULT_BLOCK_SIZE;
+    in.seekg(0, std::ios::end);
+    uint64_t inputSize = static_cast<uint64_t>(std::max<std::streamoff>(in.tellg(), 0));
+    in.seekg(0);
+    uint64_t blocks = (inputSize + blockSize - 1) / blockSize;
+    threads = std::max<size_t>(std::min<uint64_t>({threads, ThreadPool::maxThreads(), blocks}), 1);
+
+    // The original length is patched in once the input has been read.
+    std::string header;
+    writeContainerHeader(header, HUFFMAN_BLOCKED_VERSION, 0, 0, codec);
+    putLE(header, blockSize, 4);
+    out.write(header.data(), header.size());
+    compressedBytes = header.size();
+    originalBytes = 0;
+
+    // One batch = one block per worker; batches are written in order, so the output
+    // does not depend on the thread count.
+    ThreadPool pool(threads);
+    std::vector<std::string> inputs(threads), outputs(threads);
+    bool atEnd = false;
+    while (!atEnd) {
+        size_t batch = 0;
+        for (; batch < threads && !atEnd; batch++) {
+            inputs[batch].resize(blockSize);
+            in.read(&inputs[batch][0], blockSize);
+            inputs[batch].resize(static_cast<size_t>(in.gcount()));
+            if (inputs[batch].size() < blockSize) atEnd = true;
+            if (inputs[batch].empty()) break;
+        }
+        for (size_t b = 0; b < batch; b++)
+            pool.submit([&, b] {
+                outputs[b].clear();
+                compressHuffmanBlock(inputs[b].data(), inputs[b].size(), outputs[b], codec);
+            });
+        pool.wait();
+        for (size_t b = 0; b < batch; b++) {
+            out.write(outputs[b].data(), outputs[b].size());
+            originalBytes += inputs[b].size();
+            compressedBytes += outputs[b].size();
+        }
+    }
+
+    std::string length;
+    putLE(length, originalBytes, 8);
+    out.seekp(8);
+    out.write(length.data(), length.size());
+    return static_cast<bool>(out);
+}
+
+bool compressHuffmanFile(const std::string& inputPath, const std::string& outputPath,
+                         uint64_t& originalBytes, uint64_t& compressedBytes,
+                         size_t threads, size_t blockSize, uint8_t codec) {
+    std::ifstream in(inputPath, std::ios::binary);
+    if (!in) return false;
+    std::string tempPath = tempOutputPath(outputPath);
+    std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+    if (!out) return false;
+    bool ok = compressToStream(in, out, originalBytes, compressedBytes, threads, blockSize, codec);
+    return finishOutput(out, ok, tempPath, outputPath);
+}
+
+// Streaming decoder for version 1 containers (single table, one payload).
+static bool decompressSingleFile(std::ifstream& in, std::ofstream& out, std::string& header,
+                                 uint64_t& originalBytes, uint64_t& compressedBytes) {
+    uint64_t originalLength;
+    uint8_t lengths[256];
+    size_t tableSize, headerBytes;
+    if (!readContainerHeader(header, originalLength, lengths, tableSize, headerBytes)) return false;
+    HuffmanDecoder decoder;
+    if (!decoder.init(lengths, static_cast<int>(tableSize))) return false;
+
+    // Payload bytes not yet fully consumed are kept at the front of `input`, with
+    // bitOffset bits of the first byte already used.
+    std::vector<unsigned char> input(HUFFMAN_STREAM_CHUNK);
+    size_t have = header.size() - headerBytes;
+    std::copy(header.begin() + headerBytes, header.end(), input.begin());
+    int bitOffset = 0;
+    bool atEnd = false;
+    std::vector<char> output(HUFFMAN_STREAM_CHUNK);
+    uint64_t remaining = originalLength;
+    compressedBytes = header.size();
+
+    while (remaining > 0) {
+        if (!atEnd) {
+            in.read(reinterpret_cast<char*>(input.data()) + have, input.size() - have);
+            size_t got = static_cast<size_t>(in.gcount());
+            have += got;
+            compressedBytes += got;
+            atEnd = got == 0 || in.eof();
+        }
+
+        BitReader reader(input.data(), have);
+        reader.refill();
+        reader.consume(bitOffset);
+        // Unless this is the last of the input, stop while a full batch (<= 56 bits)
+        // is still guaranteed to lie inside the buffer.
+        uint64_t safeBits = have * 8;
+        uint64_t produced = 0;
+        while (remaining > 0 && produced < output.size() &&
+               (atEnd || reader.bitsConsumed() + 64 <= safeBits)) {
+            uint64_t want = std::min<uint64_t>({remaining, output.size() - produced, 4});
+            uint64_t got = decodeSymbols(decoder, reader, output.data() + produced, want);
+            produced += got;
+            remaining -= got;
+            if (got != want) return false;
+        }
+        if (reader.overrun()) return false;
+        out.write(output.data(), produced);
+
+        size_t usedBytes = static_cast<size_t>(reader.bitsConsumed() / 8);
+        bitOffset = static_cast<int>(reader.bitsConsumed() % 8);
+        std::copy(input.begin() + usedBytes, input.begin() + have, input.begin());
+        have -= usedBytes;
+        if (atEnd && produced == 0 && remaining > 0) return false;
+    }
+    originalBytes = originalLength;
+    return true;
+}
+
+// Streaming decoder for version 2 containers: reads one block per worker, decodes the
+// batch in parallel and writes it out in order.
+static bool decompressBlockedFile(std::ifstream& in, std::ofstream& out, const std::string& header,
+                                  uint64_t& originalBytes, uint64_t& compressedBytes, size_t threads) {
+    if (header.size() < HUFFMAN_BLOCKED_HEADER_SIZE) return false;
+    uint8_t codec = static_cast<uint8_t>(header[5]);
+    if (!isKnownCodec(codec)) return false;
+    uint64_t originalLength = getLE(header, 8, 8);
+    uint64_t blockSize = getLE(header, 16, 4);
+
+    // Resume reading right after the fixed header.
+    in.clear();
+    in.seekg(0, std::ios::end);
+    uint64_t fileSize = static_cast<uint64_t>(std::max<std::streamoff>(in.tellg(), 0));
+    in.seekg(HUFFMAN_BLOCKED_HEADER_SIZE);
+    if (fileSize < HUFFMAN_BLOCKED_HEADER_SIZE ||
+        originalLength > maxDecodedLength(codec, fileSize - HUFFMAN_BLOCKED_HEADER_SIZE))
+        return false;
+    compressedBytes = HUFFMAN_BLOCKED_HEADER_SIZE;
+    originalBytes = 0;
+
+    uint64_t blocks = blockSize ? (originalLength + blockSize - 1) / blockSize : 1;
+    threads = std::max<size_t>(std::min<uint64_t>({threads, ThreadPool::maxThreads(), blocks}), 1);
+    ThreadPool pool(threads);
+    std::vector<std::string> inputs(threads), outputs(threads);
+    std::vector<char> ok(threads);
+    while (originalBytes < originalLength) {
+        size_t batch = 0;
+        for (; batch < threads && originalBytes < originalLength; batch++) {
+            unsigned char prefix[HUFFMAN_BLOCK_HEADER_SIZE];
+            if (!in.read(reinterpret_cast<char*>(prefix), sizeof(prefix))) break;
+            uint64_t rawLength = getLE(prefix, 4);
+            uint64_t encodedLength = getLE(prefix + 4, 4);
+            // Bounds against corrupt lengths before allocating.
+            if (encodedLength > fileSize - compressedBytes - sizeof(prefix) || rawLength > blockSize ||
+                rawLength > originalLength - originalBytes || rawLength > maxDecodedLength(codec, encodedLength))
+                return false;
+            inputs[batch].resize(encodedLength);
+            if (!in.read(&inputs[batch][0], encodedLength)) return false;
+            outputs[batch].resize(rawLength);
+            originalBytes += rawLength;
+            compressedBytes += sizeof(prefix) + encodedLength;
+        }
+        if (batch == 0) return false;
+        for (size_t b = 0; b < batch; b++)
+            pool.submit([&, b] {
+                ok[b] = decompressHuffmanBlock(reinterpret_cast<const unsigned char*>(inputs[b].data()),
+                                               inputs[b].size(), &outputs[b][0], outputs[b].size(), codec);
+            });
+        pool.wait();
+        for (size_t b = 0; b < batch; b++) {
+            if (!ok[b]) return false;
+            out.write(outputs[b].data(), outputs[b].size());
+        }
+    }
+    return originalBytes == originalLength;
+}
+
+bool decompressHuffmanFile(const std::string& inputPath, const std::string& outputPath,
+                           uint64_t& originalBytes, uint64_t& compressedBytes, size_t threads) {
+    std::ifstream in(inputPath, std::ios::binary);
+    if (!in) return false;
+
+    std::string header(HUFFMAN_HEADER_SIZE + 128, '\0');
+    in.read(&header[0], header.size());
+    header.resize(static_cast<size_t>(in.gcount()));
+    if (!isHuffmanContainer(header)) return false;
+
+    std::string tempPath = tempOutputPath(outputPath);
+    std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+    if (!out) return false;
+    bool ok = static_cast<uint8_t>(header[4]) == HUFFMAN_BLOCKED_VERSION
+        ? decompressBlockedFile(in, out, header, originalBytes, compressedBytes, threads)
+        : decompressSingleFile(in, out, header, originalBytes, compressedBytes);
+    return finishOutput(out, ok, tempPath, outputPath);
+}
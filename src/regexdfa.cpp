@@ -0,0 +1,579 @@
+#include "regexdfa.h"
+#include "search.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+namespace {
+
+const int REGEX_MAX_REPEAT = 1000;
+const size_t REGEX_MAX_NFA_STATES = 200000;
+
+// Parse tree. SET nodes refer to a byte set by index, so copies made for {m,n} share it.
+struct Node {
+    enum Type { SET, CAT, ALT, REPEAT, EMPTY } type = EMPTY;
+    int byteSet = -1;
+    int min = 0, max = -1;  // REPEAT; max -1 = unbounded
+    vector<Node> children;
+};
+
+bool hasByte(const vector<uint64_t>& set, unsigned char byte) { return set[byte >> 6] >> (byte & 63) & 1; }
+void addByte(vector<uint64_t>& set, unsigned char byte) { set[byte >> 6] |= 1ULL << (byte & 63); }
+
+void addEscapeClass(vector<uint64_t>& set, char kind) {
+    for (int b = 0; b < 256; b++) {
+        bool member = kind == 'd' || kind == 'D' ? isdigit(b)
+                    : kind == 'w' || kind == 'W' ? isalnum(b) || b == '_'
+                    : b == ' ' || b == '\t' || b == '\r' || b == '\f' || b == '\v';
+        if (member != static_cast<bool>(isupper(kind))) addByte(set, static_cast<unsigned char>(b));
+    }
+}
+
+char escapedByte(char c) {
+    switch (c) {
+        case 't': return '\t';
+        case 'r': return '\r';
+        case 'f': return '\f';
+        case 'v': return '\v';
+        case 'n': return '\n';
+        default: return c;
+    }
+}
+
+class Parser {
+public:
+    Parser(const string& pattern, vector<vector<uint64_t>>& sets, string& error)
+        : pattern(pattern), pos(0), sets(sets), error(error) {}
+
+    bool parse(Node& root) {
+        if (!parseAlt(root)) return false;
+        if (pos < pattern.size()) return fail("')' bina '(' ke");
+        return true;
+    }
+
+private:
+    const string& pattern;
+    size_t pos;
+    vector<vector<uint64_t>>& sets;
+    string& error;
+
+    bool fail(const string& message) {
+        error = "Bhai! Regex mein gadbad (position " + to_string(pos) + "): " + message;
+        return false;
+    }
+    bool atEnd() const { return pos >= pattern.size(); }
+
+    // Newline is dropped from every set: matches never cross a line.
+    Node setNode(vector<uint64_t> set) {
+        set['\n' >> 6] &= ~(1ULL << ('\n' & 63));
+        Node node;
+        node.type = Node::SET;
+        auto it = find(sets.begin(), sets.end(), set);
+        node.byteSet = static_cast<int>(it - sets.begin());
+        if (it == sets.end()) sets.push_back(set);
+        return node;
+    }
+
+    bool parseAlt(Node& node) {
+        Node first;
+        if (!parseConcat(first)) return false;
+        if (atEnd() || pattern[pos] != '|') {
+            node = move(first);
+            return true;
+        }
+        node.type = Node::ALT;
+        node.children.push_back(move(first));
+        while (!atEnd() && pattern[pos] == '|') {
+            pos++;
+            Node next;
+            if (!parseConcat(next)) return false;
+            node.children.push_back(move(next));
+        }
+        return true;
+    }
+
+    bool parseConcat(Node& node) {
+        node.type = Node::CAT;
+        while (!atEnd() && pattern[pos] != '|' && pattern[pos] != ')') {
+            Node item;
+            if (!parseRepeat(item)) return false;
+            node.children.push_back(move(item));
+        }
+        if (node.children.size() == 1) node = Node(move(node.children[0]));
+        else if (node.children.empty()) node.type = Node::EMPTY;
+        return true;
+    }
+
+    bool readNumber(int& value) {
+        size_t begin = pos;
+        value = 0;
+        while (!atEnd() && isdigit(static_cast<unsigned char>(pattern[pos])) && value <= REGEX_MAX_REPEAT)
+            value = value * 10 + (pattern[pos++] - '0');
+        return pos > begin;
+    }
+
+    bool parseRepeat(Node& node) {
+        if (!parseAtom(node)) return false;
+        while (!atEnd()) {
+            int min, max;
+            char c = pattern[pos];
+            if (c == '*' || c == '+' || c == '?') {
+                min = c == '+' ? 1 : 0;
+                max = c == '?' ? 1 : -1;
+                pos++;
+            } else if (c == '{') {
+                // "{m}", "{m,}" or "{m,n}"; anything else is a literal '{'.
+                size_t saved = pos++;
+                if (!readNumber(min)) {
+                    pos = saved;
+                    return true;
+                }
+                max = min;
+                if (!atEnd() && pattern[pos] == ',') {
+                    pos++;
+                    if (!readNumber(max)) max = -1;
+                }
+                if (atEnd() || pattern[pos] != '}') {
+                    pos = saved;
+                    return true;
+                }
+                pos++;
+                if (min > REGEX_MAX_REPEAT || max > REGEX_MAX_REPEAT) return fail("repeat " + to_string(REGEX_MAX_REPEAT) + " se zyada");
+                if (max >= 0 && max < min) return fail("{m,n} mein n < m");
+            } else {
+                return true;
+            }
+            Node repeat;
+            repeat.type = Node::REPEAT;
+            repeat.min = min;
+            repeat.max = max;
+            repeat.children.push_back(move(node));
+            node = move(repeat);
+        }
+        return true;
+    }
+
+    bool parseAtom(Node& node) {
+        char c = pattern[pos];
+        vector<uint64_t> set(4, 0);
+        if (c == '(') {
+            pos++;
+            if (!parseAlt(node)) return false;
+            if (atEnd() || pattern[pos] != ')') return fail("')' missing hai");
+            pos++;
+            return true;
+        }
+        if (c == '*' || c == '+' || c == '?') return fail(string("'") + c + "' se pehle kuch to do");
+        if (c == '^' || c == '$') return fail("'^' aur '$' sirf pattern ke shuru/aakhir mein chalte hain");
+        if (c == '[') return parseClass(node);
+        pos++;
+        if (c == '.') {
+            set.assign(4, ~0ULL);
+        } else if (c == '\\') {
+            if (atEnd()) return fail("'\\' ke baad kuch nahi");
+            char e = pattern[pos++];
+            if (e && strchr("dDwWsS", e)) addEscapeClass(set, e);
+            else addByte(set, static_cast<unsigned char>(escapedByte(e)));
+        } else {
+            addByte(set, static_cast<unsigned char>(c));
+        }
+        node = setNode(set);
+        return true;
+    }
+
+    bool parseClass(Node& node) {
+        pos++;  // '['
+        bool negate = !atEnd() && pattern[pos] == '^';
+        if (negate) pos++;
+        vector<uint64_t> set(4, 0);
+        bool first = true;
+        while (!atEnd() && (pattern[pos] != ']' || first)) {
+            first = false;
+            unsigned char low = static_cast<unsigned char>(pattern[pos++]);
+            if (low == '\\') {
+                if (atEnd()) break;
+                char e = pattern[pos++];
+                if (e && strchr("dDwWsS", e)) {
+                    addEscapeClass(set, e);
+                    continue;
+                }
+                low = static_cast<unsigned char>(escapedByte(e));
+            }
+            unsigned char high = low;
+            if (pos + 1 < pattern.size() && pattern[pos] == '-' && pattern[pos + 1] != ']') {
+                pos++;
+                high = static_cast<unsigned char>(pattern[pos++]);
+                if (high == '\\' && !atEnd()) high = static_cast<unsigned char>(escapedByte(pattern[pos++]));
+                if (high < low) return fail("range ulti hai");
+            }
+            for (int b = low; b <= high; b++) addByte(set, static_cast<unsigned char>(b));
+        }
+        if (atEnd()) return fail("']' missing hai");
+        pos++;
+        if (negate)
+            for (auto& word : set) word = ~word;
+        node = setNode(set);
+        return true;
+    }
+};
+
+// What every match of a subtree looks like, for the literal prefilter: `exact` when the
+// subtree always matches exactly `text`; `required` is a substring of every match.
+struct LiteralInfo {
+    bool exact;
+    string text, required;
+};
+
+const string& longer(const string& a, const string& b) { return b.size() > a.size() ? b : a; }
+
+LiteralInfo analyze(const Node& node, const vector<vector<uint64_t>>& sets) {
+    switch (node.type) {
+        case Node::EMPTY:
+            return {true, "", ""};
+        case Node::SET: {
+            const vector<uint64_t>& set = sets[node.byteSet];
+            int count = 0, member = 0;
+            for (int b = 0; b < 256; b++)
+                if (hasByte(set, static_cast<unsigned char>(b))) count++, member = b;
+            if (count != 1) return {false, "", ""};
+            string text(1, static_cast<char>(member));
+            return {true, text, text};
+        }
+        case Node::CAT: {
+            LiteralInfo result{true, "", ""};
+            string run;
+            for (const Node& child : node.children) {
+                LiteralInfo info = analyze(child, sets);
+                if (info.exact) {
+                    run += info.text;
+                    continue;
+                }
+                result.exact = false;
+                result.required = longer(longer(result.required, run), info.required);
+                run.clear();
+            }
+            result.required = longer(result.required, run);
+            if (result.exact) result.text = run;
+            return result;
+        }
+        case Node::ALT: {
+            LiteralInfo first = analyze(node.children[0], sets);
+            for (size_t i = 1; i < node.children.size(); i++) {
+                LiteralInfo info = analyze(node.children[i], sets);
+                if (!first.exact || !info.exact || info.text != first.text) return {false, "", ""};
+            }
+            return first;
+        }
+        case Node::REPEAT: {
+            if (node.min == 0) return {node.max == 0, "", ""};
+            LiteralInfo info = analyze(node.children[0], sets);
+            string repeated;
+            if (info.exact)
+                for (int i = 0; i < node.min; i++) repeated += info.text;
+            if (info.exact && node.max == node.min) return {true, repeated, repeated};
+            return {false, "", info.exact ? repeated : info.required};
+        }
+    }
+    return {false, "", ""};
+}
+
+}  // namespace
+
+// Thompson construction, built back to front: emit(node, next) returns the entry state of
+// a fragment that continues to `next` once the node has matched. `reversed` builds the NFA
+// of the reversed language (concatenations back to front), which reads text right to left.
+static int emit(const Node& node, int next, vector<RegexProgram::State>& states, bool& overflow, bool reversed);
+
+bool RegexProgram::compile(const string& source, string& error) {
+    string pattern = source;
+    anchorStart = !pattern.empty() && pattern[0] == '^';
+    if (anchorStart) pattern.erase(0, 1);
+    size_t slashes = 0;
+    while (slashes + 1 < pattern.size() && pattern[pattern.size() - 2 - slashes] == '\\') slashes++;
+    anchorEnd = !pattern.empty() && pattern.back() == '$' && slashes % 2 == 0;
+    if (anchorEnd) pattern.pop_back();
+
+    byteSets.clear();
+    states.clear();
+    Node root;
+    Parser parser(pattern, byteSets, error);
+    if (!parser.parse(root)) return false;
+
+    states.push_back({MATCH, -1, -1, -1});
+    reverseStates.clear();
+    reverseStates.push_back({MATCH, -1, -1, -1});
+    bool overflow = false;
+    start = emit(root, 0, states, overflow, false);
+    reverseStart = emit(root, 0, reverseStates, overflow, true);
+    if (overflow) {
+        error = "Bhai! Regex bahut bada ban raha hai, repeats kam karo.";
+        return false;
+    }
+    literal = analyze(root, byteSets).required;
+
+    // Byte classes: bytes that every set treats alike share a class. Newline always gets
+    // a class of its own since it ends a line.
+    map<string, int> classes;
+    for (int b = 0; b < 256; b++) {
+        string signature(1, b == '\n' ? '\1' : '\0');
+        for (const auto& set : byteSets) signature += hasByte(set, static_cast<unsigned char>(b)) ? '1' : '0';
+        auto it = classes.emplace(signature, static_cast<int>(classes.size())).first;
+        byteClass[b] = static_cast<uint8_t>(it->second);
+    }
+    classCount = static_cast<int>(classes.size());
+    return true;
+}
+
+static int emit(const Node& node, int next, vector<RegexProgram::State>& states, bool& overflow, bool reversed) {
+    if (states.size() > REGEX_MAX_NFA_STATES) {
+        overflow = true;
+        return next;
+    }
+    auto add = [&states](RegexProgram::Kind kind, int byteSet, int out, int out1) {
+        states.push_back({kind, byteSet, out, out1});
+        return static_cast<int>(states.size() - 1);
+    };
+    switch (node.type) {
+        case Node::EMPTY:
+            return next;
+        case Node::SET:
+            return add(RegexProgram::BYTES, node.byteSet, next, -1);
+        case Node::CAT:
+            if (reversed) {
+                for (const Node& child : node.children) next = emit(child, next, states, overflow, true);
+            } else {
+                for (auto child = node.children.rbegin(); child != node.children.rend(); ++child)
+                    next = emit(*child, next, states, overflow, false);
+            }
+            return next;
+        case Node::ALT: {
+            int entry = emit(node.children.back(), next, states, overflow, reversed);
+            for (size_t i = node.children.size() - 1; i-- > 0;)
+                entry = add(RegexProgram::SPLIT, -1, emit(node.children[i], next, states, overflow, reversed), entry);
+            return entry;
+        }
+        case Node::REPEAT: {
+            const Node& child = node.children[0];
+            int entry = next;
+            int required = node.min;
+            if (node.max < 0) {
+                // Loop: split -> child -> split, or on to next. With min >= 1 the last required
+                // copy doubles as the loop body (x+).
+                int split = add(RegexProgram::SPLIT, -1, -1, next);
+                int body = emit(child, split, states, overflow, reversed);
+                states[split].out = body;
+                entry = required > 0 ? body : split;
+                if (required > 0) required--;
+            } else {
+                for (int i = node.min; i < node.max; i++)
+                    entry = add(RegexProgram::SPLIT, -1, emit(child, entry, states, overflow, reversed), next);
+            }
+            for (int i = 0; i < required; i++) entry = emit(child, entry, states, overflow, reversed);
+            return entry;
+        }
+    }
+    return next;
+}
+
+RegexSearcher::RegexSearcher(const RegexProgram& program, size_t maxStates)
+    : program(program), maxStates(std::max<size_t>(maxStates, 16)) {
+    anchored.floating = false;
+    anchored.reverse = false;
+    floating.floating = true;
+    floating.reverse = false;
+    reverse.floating = true;
+    reverse.reverse = true;
+    for (Dfa* dfa : {&anchored, &floating, &reverse}) {
+        vector<uint8_t> seen(nfa(*dfa).size(), 0);
+        vector<int>& set = dfa->reverse ? reverseStartSet : startSet;
+        if (set.empty()) {
+            addClosure(*dfa, dfa->reverse ? program.reverseStart : program.start, set, seen);
+            sort(set.begin(), set.end());
+        }
+        resetDfa(*dfa);
+    }
+}
+
+void RegexSearcher::addClosure(const Dfa& dfa, int state, vector<int>& set, vector<uint8_t>& seen) const {
+    const vector<RegexProgram::State>& states = nfa(dfa);
+    vector<int> pending = {state};
+    while (!pending.empty()) {
+        int s = pending.back();
+        pending.pop_back();
+        if (seen[s]) continue;
+        seen[s] = 1;
+        const RegexProgram::State& node = states[s];
+        if (node.kind == RegexProgram::SPLIT) {
+            pending.push_back(node.out1);
+            pending.push_back(node.out);
+        } else {
+            set.push_back(s);
+        }
+    }
+}
+
+void RegexSearcher::resetDfa(Dfa& dfa) {
+    dfa.ids.clear();
+    dfa.sets.clear();
+    dfa.match.clear();
+    dfa.next.clear();
+    vector<int> start = dfa.reverse ? reverseStartSet : startSet;
+    intern(dfa, start);
+}
+
+int32_t RegexSearcher::intern(Dfa& dfa, vector<int>& set) {
+    auto it = dfa.ids.find(set);
+    if (it != dfa.ids.end()) return it->second;
+    int32_t id = static_cast<int32_t>(dfa.sets.size());
+    bool matching = false;
+    for (int s : set) matching |= nfa(dfa)[s].kind == RegexProgram::MATCH;
+    dfa.ids.emplace(set, id);
+    dfa.sets.push_back(move(set));
+    dfa.match.push_back(matching);
+    dfa.next.resize(dfa.next.size() + program.classCount, -1);
+    built++;
+    return id;
+}
+
+int32_t RegexSearcher::step(Dfa& dfa, int32_t state, unsigned char byte) {
+    size_t slot = static_cast<size_t>(state) * program.classCount + program.byteClass[byte];
+    if (dfa.next[slot] >= 0) return dfa.next[slot];
+
+    // Every byte of a class moves the NFA the same way, so this byte stands for its class.
+    const vector<RegexProgram::State>& states = nfa(dfa);
+    vector<int> target;
+    vector<uint8_t> seen(states.size(), 0);
+    for (int s : dfa.sets[state]) {
+        const RegexProgram::State& node = states[s];
+        if (node.kind == RegexProgram::BYTES && hasByte(program.byteSets[node.byteSet], byte))
+            addClosure(dfa, node.out, target, seen);
+    }
+    // Read backwards, a line starts (for the reversed pattern) where '$' would be.
+    bool anchored = dfa.reverse ? program.anchorEnd : program.anchorStart;
+    if (dfa.floating && (!anchored || byte == '\n'))
+        for (int s : dfa.reverse ? reverseStartSet : startSet)
+            if (!seen[s]) {
+                seen[s] = 1;
+                target.push_back(s);
+            }
+    sort(target.begin(), target.end());
+
+    // A full cache is dropped wholesale and refilled from here on; the caller only holds
+    // the state this call returns.
+    if (dfa.sets.size() >= maxStates) {
+        resetDfa(dfa);
+        flushes++;
+        return intern(dfa, target);
+    }
+    int32_t id = intern(dfa, target);
+    dfa.next[slot] = id;
+    return id;
+}
+
+size_t RegexSearcher::longestFrom(const unsigned char* text, size_t begin, size_t lineEnd, bool shared) {
+    int32_t state = 0;
+    size_t best = anchored.match[0] && (!program.anchorEnd || begin == lineEnd) ? begin : SIZE_MAX;
+    for (size_t i = begin; i < lineEnd; i++) {
+        state = step(anchored, state, text[i]);
+        steps++;
+        if (isDead(anchored, state)) break;
+        if (anchored.match[state] && (!program.anchorEnd || i + 1 == lineEnd)) best = i + 1;
+        if (!shared) continue;
+        if (visitedFlushes != flushes) {  // state ids were renumbered
+            visited.clear();
+            visitedFlushes = flushes;
+        }
+        if (!visited.insert(static_cast<uint64_t>(i + 1) << 32 | static_cast<uint32_t>(state)).second) break;
+    }
+    return best;
+}
+
+bool RegexSearcher::matchInLine(const unsigned char* text, size_t size, size_t from, size_t lineEnd,
+                                size_t& start, size_t& end) {
+    if (program.anchorStart) {
+        // Only the line's own start can begin a match.
+        if (from > 0 && text[from - 1] != '\n') return false;
+        end = longestFrom(text, from, lineEnd);
+        start = from;
+        return end != SIZE_MAX;
+    }
+    // Where matches can begin: one right-to-left pass of the reversed pattern over the
+    // line, kept while the caller walks on through the same line.
+    bool cached = continuesLine(text, size, from) && lineEnd == startsEnd;
+    if (!cached) {
+        startable.assign(lineEnd - from + 1, 0);
+        int32_t state = 0;
+        startable[lineEnd - from] = reverse.match[0];
+        for (size_t p = lineEnd; p-- > from;) {
+            state = step(reverse, state, text[p]);
+            startable[p - from] = reverse.match[state];
+        }
+        startsText = text;
+        startsSize = size;
+        startsBegin = from;
+        startsEnd = lineEnd;
+        visited.clear();
+    }
+    // The leftmost start, then the longest match from it. Every run made on this line so
+    // far started before `from` and found its last match end at or before it, so a run
+    // that reaches a (position, state) one of them went through will find no end further
+    // on either and can stop there: each pair is stepped through at most once per line.
+    for (size_t p = from; p <= lineEnd; p++) {
+        if (!startable[p - startsBegin]) continue;
+        end = longestFrom(text, p, lineEnd, true);
+        if (end == SIZE_MAX) continue;
+        start = p;
+        lastEnd = end;
+        return true;
+    }
+    return false;
+}
+
+bool RegexSearcher::nextMatch(const char* text, size_t size, size_t from, size_t& start, size_t& end) {
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(text);
+    const string& literal = program.literal;
+    // Every position up to the end of the last line; a final newline ends the last line
+    // rather than starting an empty one.
+    size_t last = size > 0 && bytes[size - 1] == '\n' ? size - 1 : size;
+    if (size == 0) return false;
+    size_t pos = from;
+    while (pos <= last) {
+        // Find a position on a line that may hold a match: the next occurrence of the
+        // required literal, or else where the floating DFA first sees a match end.
+        size_t hit = SEARCH_NPOS;
+        if (!literal.empty()) {
+            hit = searchFirst(text, size, literal.data(), literal.size(), pos);
+        } else if (program.anchorStart && pos > 0 && bytes[pos - 1] != '\n') {
+            const void* newline = memchr(text + pos, '\n', size - pos);
+            if (!newline) return false;
+            pos = static_cast<const char*>(newline) - text + 1;
+            continue;
+        } else {
+            auto endsHere = [&](size_t i) { return !program.anchorEnd || i == size || bytes[i] == '\n'; };
+            int32_t state = 0;
+            if (floating.match[state] && endsHere(pos)) hit = pos;  // an empty match
+            for (size_t i = pos; hit == SEARCH_NPOS && i < last; i++) {
+                state = step(floating, state, bytes[i]);
+                // After a newline only an empty match at the start of the next line is left.
+                if (floating.match[state] && endsHere(i + 1)) hit = bytes[i] == '\n' ? i + 1 : i;
+            }
+        }
+        if (hit == SEARCH_NPOS || hit > last) return false;
+
+        const void* before = hit > pos ? memrchr(text + pos, '\n', hit - pos) : nullptr;
+        size_t lineStart = before ? static_cast<const char*>(before) - text + 1 : pos;
+        // Still on the line the previous match came from: its end is known, and looking for
+        // it again after every match would make a line with many matches quadratic.
+        size_t lineEnd;
+        if (continuesLine(bytes, size, from) && hit <= startsEnd) {
+            lineEnd = startsEnd;
+        } else {
+            const void* after = memchr(text + hit, '\n', size - hit);
+            lineEnd = after ? static_cast<const char*>(after) - text : size;
+        }
+        if (matchInLine(bytes, size, lineStart, lineEnd, start, end)) return true;
+        pos = lineEnd + 1;
+    }
+    return false;
+}
@@ -0,0 +1,170 @@
+#include "search.h"
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SEARCH_HAVE_X86 1
+#endif
+
+using namespace std;
+
+namespace {
+
+typedef size_t (*SearchKernel)(const char*, size_t, const char*, size_t);
+typedef size_t (*CountKernel)(const char*, size_t, char);
+
+size_t countScalar(const char* text, size_t size, char byte) {
+    size_t count = 0;
+    for (size_t i = 0; i < size; i++) count += text[i] == byte;
+    return count;
+}
+
+// First occurrence in text[0, size); the pattern is at least two bytes long.
+size_t searchScalar(const char* text, size_t size, const char* pattern, size_t m) {
+    const char* end = text + size - m + 1;
+    const char* p = text;
+    while (p < end) {
+        p = static_cast<const char*>(memchr(p, pattern[0], end - p));
+        if (!p) return SEARCH_NPOS;
+        if (p[m - 1] == pattern[m - 1] && memcmp(p + 1, pattern + 1, m - 2) == 0) return p - text;
+        p++;
+    }
+    return SEARCH_NPOS;
+}
+
+#ifdef SEARCH_HAVE_X86
+size_t searchSse2(const char* text, size_t size, const char* pattern, size_t m) {
+    const __m128i first = _mm_set1_epi8(pattern[0]);
+    const __m128i last = _mm_set1_epi8(pattern[m - 1]);
+    size_t i = 0;
+    for (; i + m - 1 + 16 <= size; i += 16) {
+        __m128i blockFirst = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+        __m128i blockLast = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i + m - 1));
+        unsigned mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, blockFirst),
+                                                        _mm_cmpeq_epi8(last, blockLast)));
+        while (mask) {
+            unsigned bit = __builtin_ctz(mask);
+            if (memcmp(text + i + bit + 1, pattern + 1, m - 2) == 0) return i + bit;
+            mask &= mask - 1;
+        }
+    }
+    size_t tail = i < size ? searchScalar(text + i, size - i, pattern, m) : SEARCH_NPOS;
+    return tail == SEARCH_NPOS ? SEARCH_NPOS : i + tail;
+}
+
+size_t countSse2(const char* text, size_t size, char byte) {
+    const __m128i needle = _mm_set1_epi8(byte);
+    size_t count = 0, i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+        count += __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(block, needle)));
+    }
+    return count + countScalar(text + i, size - i, byte);
+}
+
+__attribute__((target("avx2,popcnt")))
+size_t countAvx2(const char* text, size_t size, char byte) {
+    const __m256i needle = _mm256_set1_epi8(byte);
+    size_t count = 0, i = 0;
+    // Four vectors per step keeps several compares in flight.
+    for (; i + 128 <= size; i += 128) {
+        const __m256i* p = reinterpret_cast<const __m256i*>(text + i);
+        uint64_t m0 = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256(p), needle)));
+        uint64_t m1 = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256(p + 1), needle)));
+        uint64_t m2 = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256(p + 2), needle)));
+        uint64_t m3 = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256(p + 3), needle)));
+        count += __builtin_popcountll(m0 | m1 << 32) + __builtin_popcountll(m2 | m3 << 32);
+    }
+    return count + countSse2(text + i, size - i, byte);
+}
+
+__attribute__((target("avx2")))
+size_t searchAvx2(const char* text, size_t size, const char* pattern, size_t m) {
+    const __m256i first = _mm256_set1_epi8(pattern[0]);
+    const __m256i last = _mm256_set1_epi8(pattern[m - 1]);
+    size_t i = 0;
+    for (; i + m - 1 + 32 <= size; i += 32) {
+        __m256i blockFirst = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + i));
+        __m256i blockLast = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + i + m - 1));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(first, blockFirst), _mm256_cmpeq_epi8(last, blockLast))));
+        while (mask) {
+            unsigned bit = __builtin_ctz(mask);
+            if (memcmp(text + i + bit + 1, pattern + 1, m - 2) == 0) return i + bit;
+            mask &= mask - 1;
+        }
+    }
+    size_t tail = i < size ? searchSse2(text + i, size - i, pattern, m) : SEARCH_NPOS;
+    return tail == SEARCH_NPOS ? SEARCH_NPOS : i + tail;
+}
+#endif
+
+struct Dispatch {
+    SearchKernel kernel;
+    CountKernel count;
+    const char* name;
+};
+
+Dispatch pickKernel() {
+#ifdef SEARCH_HAVE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) return {searchAvx2, countAvx2, "avx2"};
+    if (__builtin_cpu_supports("sse2")) return {searchSse2, countSse2, "sse2"};
+#endif
+    return {searchScalar, countScalar, "scalar"};
+}
+
+const Dispatch& dispatch() {
+    static const Dispatch chosen = pickKernel();
+    return chosen;
+}
+
+}  // namespace
+
+size_t searchFirst(const char* text, size_t size, const char* pattern, size_t patternSize, size_t from) {
+    if (patternSize == 0 || from > size || size - from < patternSize) return SEARCH_NPOS;
+    if (patternSize == 1) {
+        const void* hit = memchr(text + from, pattern[0], size - from);
+        return hit ? static_cast<const char*>(hit) - text : SEARCH_NPOS;
+    }
+    size_t hit = dispatch().kernel(text + from, size - from, pattern, patternSize);
+    return hit == SEARCH_NPOS ? SEARCH_NPOS : from + hit;
+}
+
+vector<size_t> searchAll(const char* text, size_t size, const string& pattern) {
+    vector<size_t> hits;
+    for (size_t pos = searchFirst(text, size, pattern.data(), pattern.size()); pos != SEARCH_NPOS;
+         pos = searchFirst(text, size, pattern.data(), pattern.size(), pos + 1))
+        hits.push_back(pos);
+    return hits;
+}
+
+size_t countByte(const char* text, size_t size, char byte) {
+    return dispatch().count(text, size, byte);
+}
+
+const char* searchKernelName() {
+    return dispatch().name;
+}
+
+bool looksBinary(const char* text, size_t size) {
+    return memchr(text, '\0', min(size, BINARY_PROBE_BYTES)) != nullptr;
+}
+
+void LineLocator::locate(size_t pos, size_t& lineNumber, size_t& column) {
+    if (pos > scanned) {
+        size_t newlines = countByte(text + scanned, pos - scanned, '\n');
+        if (newlines > 0) {
+            line += newlines;
+            lineStart = static_cast<const char*>(memrchr(text + scanned, '\n', pos - scanned)) - text + 1;
+        }
+        scanned = pos;
+    }
+    lineNumber = line;
+    column = pos - lineStart;
+}
+
+size_t LineLocator::totalNewlines() {
+    return line - 1 + countByte(text + scanned, size - scanned, '\n');
+}
@@ -0,0 +1,44 @@
+#include "stringpool.h"
+#include <functional>
+
+using namespace std;
+
+StringPool::StringPool() : offsets(1, 0), table(1024, NOT_FOUND) {}
+
+// The slot holding text, or the free slot where it would go.
+size_t StringPool::slotOf(string_view text) const {
+    size_t mask = table.size() - 1;
+    size_t slot = hash<string_view>()(text) & mask;
+    while (table[slot] != NOT_FOUND && view(table[slot]) != text) slot = (slot + 1) & mask;
+    return slot;
+}
+
+uint32_t StringPool::find(string_view text) const {
+    return table[slotOf(text)];
+}
+
+uint32_t StringPool::intern(string_view text) {
+    size_t slot = slotOf(text);
+    if (table[slot] != NOT_FOUND) return table[slot];
+
+    uint32_t id = static_cast<uint32_t>(size());
+    chars.insert(chars.end(), text.begin(), text.end());
+    chars.push_back('\0');
+    offsets.push_back(static_cast<uint32_t>(chars.size()));
+    table[slot] = id;
+    // Kept at most half full so probe runs stay short.
+    if (size() * 2 > table.size()) rehash(table.size() * 2);
+    return id;
+}
+
+void StringPool::rehash(size_t slots) {
+    vector<uint32_t> old(slots, NOT_FOUND);
+    old.swap(table);
+    size_t mask = slots - 1;
+    for (uint32_t id : old) {
+        if (id == NOT_FOUND) continue;
+        size_t slot = hash<string_view>()(view(id)) & mask;
+        while (table[slot] != NOT_FOUND) slot = (slot + 1) & mask;
+        table[slot] = id;
+    }
+}
@@ -0,0 +1,96 @@
+#include "threadpool.h"
+
+namespace {
+// Which pool (and which of its deques) the calling thread works for, if any.
+thread_local const void* currentPool = nullptr;
+thread_local size_t currentQueue = 0;
+}
+
+ThreadPool::ThreadPool(size_t threads) : queued(0), nextQueue(0), pending(0), stopping(false) {
+    if (threads == 0) threads = 1;
+    for (size_t i = 0; i < threads; i++) queues.push_back(make_unique<WorkQueue>());
+    for (size_t i = 0; i < threads; i++)
+        workers.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+    }
+    taskReady.notify_all();
+    for (auto& worker : workers) worker.join();
+}
+
+size_t ThreadPool::defaultThreads() {
+    unsigned int cores = thread::hardware_concurrency();
+    return cores ? cores : 1;
+}
+
+size_t ThreadPool::maxThreads() {
+    return 4 * defaultThreads();
+}
+
+void ThreadPool::submit(function<void()> task) {
+    size_t target = currentPool == this ? currentQueue : nextQueue++ % queues.size();
+    {
+        // Counted before the push (queued never undercounts), under the pool lock so a
+        // worker deciding to sleep cannot miss it.
+        lock_guard<mutex> guard(lock);
+        queued++;
+        pending++;
+    }
+    {
+        lock_guard<mutex> guard(queues[target]->lock);
+        queues[target]->tasks.push_back(move(task));
+    }
+    taskReady.notify_one();
+}
+
+void ThreadPool::wait() {
+    unique_lock<mutex> guard(lock);
+    allDone.wait(guard, [this] { return pending == 0; });
+}
+
+bool ThreadPool::takeTask(size_t self, function<void()>& task) {
+    {
+        WorkQueue& own = *queues[self];
+        lock_guard<mutex> guard(own.lock);
+        if (!own.tasks.empty()) {
+            task = move(own.tasks.back());
+            own.tasks.pop_back();
+            queued--;
+            return true;
+        }
+    }
+    for (size_t i = 1; i < queues.size(); i++) {
+        WorkQueue& victim = *queues[(self + i) % queues.size()];
+        lock_guard<mutex> guard(victim.lock);
+        if (!victim.tasks.empty()) {
+            task = move(victim.tasks.front());
+            victim.tasks.pop_front();
+            queued--;
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::workerLoop(size_t self) {
+    currentPool = this;
+    currentQueue = self;
+    while (true) {
+        function<void()> task;
+        if (!takeTask(self, task)) {
+            unique_lock<mutex> guard(lock);
+            taskReady.wait(guard, [this] { return stopping || queued > 0; });
+            if (queued == 0) return;
+            continue;
+        }
+        task();
+        {
+            lock_guard<mutex> guard(lock);
+            if (--pending == 0) allDone.notify_all();
+        }
+    }
+}
@@ -0,0 +1,108 @@
+#include "treesnapshot.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+static void putLE(string& out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) out += static_cast<char>((value >> (8 * i)) & 0xFF);
+}
+
+string treeSnapshotPath(const string& rootPath) {
+    const char* cacheHome = getenv("XDG_CACHE_HOME");
+    const char* home = getenv("HOME");
+    string cache;
+    if (cacheHome && cacheHome[0] == '/') cache = cacheHome;
+    else if (home && home[0] == '/') cache = string(home) + "/.cache";
+    else return "";
+    string dir = cache + "/brobash";
+    mkdir(cache.c_str(), 0700);
+    if (mkdir(dir.c_str(), 0700) != 0 && errno != EEXIST) return "";
+
+    // FNV-1a of the root path: a stable name, whatever characters the path holds.
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : rootPath) hash = (hash ^ c) * 1099511628211ull;
+    char name[32];
+    snprintf(name, sizeof name, "tree-%016llx", static_cast<unsigned long long>(hash));
+    return dir + "/" + name;
+}
+
+bool writeTreeSnapshot(const string& path, const vector<SnapshotNode>& nodes, const StringPool& names) {
+    string_view blob = names.buffer();
+    string out;
+    out.reserve(TREE_SNAPSHOT_HEADER_SIZE + nodes.size() * TREE_SNAPSHOT_NODE_SIZE + blob.size());
+    uint64_t namesOffset = TREE_SNAPSHOT_HEADER_SIZE + nodes.size() * TREE_SNAPSHOT_NODE_SIZE;
+    out += "BTRE";
+    putLE(out, TREE_SNAPSHOT_VERSION, 4);
+    putLE(out, nodes.size(), 4);
+    putLE(out, 0, 4);
+    putLE(out, namesOffset, 8);
+    putLE(out, blob.size(), 8);
+    for (const SnapshotNode& node : nodes) {
+        putLE(out, static_cast<uint64_t>(node.modified), 8);
+        putLE(out, names.offset(node.name), 4);
+        putLE(out, names.view(node.name).size(), 2);
+        putLE(out, node.flags, 2);
+        putLE(out, node.firstChild, 4);
+        putLE(out, node.childCount, 4);
+    }
+    out.append(blob.data(), blob.size());
+
+    // Renamed over the old snapshot, so a crash never leaves half of one and a session
+    // still reading the old one keeps its mapping.
+    // Sessions with the same root share the file, so each writes its own temporary.
+    string tempPath = path + "." + to_string(getpid()) + ".tmp";
+    bool written;
+    {
+        ofstream file(tempPath, ios::binary | ios::trunc);
+        written = static_cast<bool>(file.write(out.data(), out.size()));
+    }
+    if (!written || rename(tempPath.c_str(), path.c_str()) != 0) {
+        remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+TreeSnapshot::TreeSnapshot(const string& path)
+    : file(path), base(nullptr), count(0), namesOffset(0), namesSize(0), valid(false) {
+    if (!file.isOpen() || file.size() < TREE_SNAPSHOT_HEADER_SIZE) return;
+    base = reinterpret_cast<const unsigned char*>(file.data());
+    if (memcmp(base, "BTRE", 4) != 0 || getLE(base + 4, 4) != TREE_SNAPSHOT_VERSION) return;
+    count = getLE(base + 8, 4);
+    namesOffset = getLE(base + 16, 8);
+    namesSize = getLE(base + 24, 8);
+    if (count == 0 || namesOffset != TREE_SNAPSHOT_HEADER_SIZE + count * TREE_SNAPSHOT_NODE_SIZE ||
+        namesOffset + namesSize != file.size())
+        return;
+    valid = true;
+}
+
+string_view TreeSnapshot::name(uint32_t node) const {
+    const unsigned char* entry = record(node);
+    uint64_t offset = getLE(entry + 8, 4), length = getLE(entry + 12, 2);
+    if (offset + length > namesSize) return string_view();
+    return string_view(reinterpret_cast<const char*>(base + namesOffset + offset), length);
+}
+
+uint32_t TreeSnapshot::childCount(uint32_t node) const {
+    uint64_t first = firstChild(node), children = getLE(record(node) + 20, 4);
+    // Children always come after their parent, which also rules out loops.
+    if (children == 0 || first <= node || first + children > count) return 0;
+    return static_cast<uint32_t>(children);
+}
+
+uint32_t TreeSnapshot::findChild(uint32_t dir, string_view childName) const {
+    uint32_t low = firstChild(dir), high = low + childCount(dir);
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        if (name(middle) < childName) low = middle + 1;
+        else high = middle;
+    }
+    return low < firstChild(dir) + childCount(dir) && name(low) == childName ? low : NONE;
+}
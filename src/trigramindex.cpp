@@ -0,0 +1,332 @@
+#include "trigramindex.h"
+#include "search.h"
+#include "threadpool.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+#include <sys/stat.h>
+
+using namespace std;
+
+static void putLE(string& out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) out += static_cast<char>((value >> (8 * i)) & 0xFF);
+}
+
+static uint64_t getLE(const unsigned char* in, int bytes) {
+    uint64_t value = 0;
+    for (int i = bytes - 1; i >= 0; i--) value = (value << 8) | in[i];
+    return value;
+}
+
+static int64_t mtimeNanos(const struct stat& info) {
+    return static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+}
+
+// Distinct trigrams of a buffer, sorted. A per-thread 2 MB bitmap over all 2^24 trigrams
+// dedupes them as they are seen; only the bits that were set are cleared afterwards.
+static void collectTrigrams(const unsigned char* p, size_t size, vector<uint32_t>& out) {
+    thread_local vector<uint64_t> seen(1 << 18, 0);
+    if (size < 3) return;
+    uint32_t trigram = p[0] << 8 | p[1];
+    for (size_t i = 2; i < size; i++) {
+        trigram = (trigram << 8 | p[i]) & 0xFFFFFF;
+        uint64_t& word = seen[trigram >> 6];
+        uint64_t bit = 1ULL << (trigram & 63);
+        if (!(word & bit)) {
+            word |= bit;
+            out.push_back(trigram);
+        }
+    }
+    for (uint32_t t : out) seen[t >> 6] = 0;
+    sort(out.begin(), out.end());
+}
+
+TrigramIndex::TrigramIndex(const string& indexPath)
+    : file(indexPath), base(nullptr), files(0), trigrams(0), pathsOffset(0), postingsOffset(0), valid(false) {
+    if (!file.isOpen() || file.size() < TRIGRAM_HEADER_SIZE) return;
+    base = reinterpret_cast<const unsigned char*>(file.data());
+    if (memcmp(base, "BTRI", 4) != 0 || getLE(base + 4, 4) != TRIGRAM_INDEX_VERSION) return;
+    files = getLE(base + 8, 4);
+    trigrams = getLE(base + 12, 4);
+    pathsOffset = getLE(base + 16, 8);
+    postingsOffset = getLE(base + 24, 8);
+    uint64_t tablesEnd = TRIGRAM_HEADER_SIZE + files * TRIGRAM_FILE_ENTRY_SIZE + trigrams * TRIGRAM_ENTRY_SIZE;
+    if (tablesEnd != pathsOffset || pathsOffset > postingsOffset || postingsOffset > file.size()) return;
+    for (size_t id = 0; id < files; id++) {
+        const unsigned char* entry = fileEntry(id);
+        if (getLE(entry + 16, 4) + getLE(entry + 20, 4) > postingsOffset - pathsOffset) return;
+    }
+    valid = true;
+}
+
+const unsigned char* TrigramIndex::trigramEntry(size_t index) const {
+    return base + TRIGRAM_HEADER_SIZE + files * TRIGRAM_FILE_ENTRY_SIZE + index * TRIGRAM_ENTRY_SIZE;
+}
+
+int64_t TrigramIndex::find(const string& path) const {
+    size_t low = 0, high = files;
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+        const unsigned char* entry = fileEntry(mid);
+        const char* name = reinterpret_cast<const char*>(base + pathsOffset + getLE(entry + 16, 4));
+        size_t length = getLE(entry + 20, 4);
+        int order = path.compare(0, string::npos, name, length);
+        if (order == 0) return static_cast<int64_t>(mid);
+        if (order < 0) high = mid;
+        else low = mid + 1;
+    }
+    return -1;
+}
+
+int64_t TrigramIndex::currentId(const string& path, const string& fullPath) const {
+    int64_t id = valid ? find(path) : -1;
+    struct stat info;
+    if (id < 0 || stat(fullPath.c_str(), &info) != 0 || !S_ISREG(info.st_mode)) return -1;
+    const unsigned char* entry = fileEntry(id);
+    bool unchanged = static_cast<int64_t>(getLE(entry, 8)) == mtimeNanos(info) &&
+                     getLE(entry + 8, 8) == static_cast<uint64_t>(info.st_size);
+    return unchanged ? id : -1;
+}
+
+bool TrigramIndex::isBinary(size_t id) const {
+    return getLE(fileEntry(id) + 24, 4) & TRIGRAM_FILE_BINARY;
+}
+
+const unsigned char* TrigramIndex::findTrigram(uint32_t trigram) const {
+    size_t low = 0, high = trigrams;
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+        uint32_t value = getLE(trigramEntry(mid), 4);
+        if (value == trigram) return trigramEntry(mid);
+        if (value < trigram) low = mid + 1;
+        else high = mid;
+    }
+    return nullptr;
+}
+
+bool TrigramIndex::decodePostings(const unsigned char* entry, vector<uint32_t>& ids) const {
+    uint64_t count = getLE(entry + 4, 4);
+    uint64_t offset = postingsOffset + getLE(entry + 8, 8);
+    const unsigned char* p = base + std::min<uint64_t>(offset, file.size());
+    const unsigned char* end = base + file.size();
+    uint64_t id = 0;
+    for (uint64_t i = 0; i < count; i++) {
+        uint64_t gap = 0;
+        for (int shift = 0;; shift += 7) {
+            if (p == end || shift > 28) return false;
+            gap |= static_cast<uint64_t>(*p & 0x7F) << shift;
+            if (!(*p++ & 0x80)) break;
+        }
+        id += gap;
+        if (id >= files) return false;
+        ids.push_back(static_cast<uint32_t>(id));
+    }
+    return true;
+}
+
+bool TrigramIndex::postings(size_t n, uint32_t& trigram, vector<uint32_t>& ids) const {
+    const unsigned char* entry = trigramEntry(n);
+    trigram = getLE(entry, 4);
+    return decodePostings(entry, ids);
+}
+
+void TrigramIndex::markCandidates(const string& pattern, vector<uint8_t>& candidate) const {
+    candidate.resize(files, 0);
+    vector<uint32_t> wanted;
+    collectTrigrams(reinterpret_cast<const unsigned char*>(pattern.data()), pattern.size(), wanted);
+    if (wanted.empty()) {
+        fill(candidate.begin(), candidate.end(), 1);
+        return;
+    }
+
+    // Intersect starting from the rarest trigram so the running set stays small.
+    vector<const unsigned char*> entries;
+    for (uint32_t trigram : wanted) {
+        const unsigned char* entry = findTrigram(trigram);
+        if (!entry) return;
+        entries.push_back(entry);
+    }
+    sort(entries.begin(), entries.end(),
+         [](const unsigned char* a, const unsigned char* b) { return getLE(a + 4, 4) < getLE(b + 4, 4); });
+    vector<uint32_t> result, next, merged;
+    auto markAll = [&candidate] { fill(candidate.begin(), candidate.end(), 1); };
+    if (!decodePostings(entries[0], result)) return markAll();
+    for (size_t i = 1; i < entries.size() && !result.empty(); i++) {
+        next.clear();
+        merged.clear();
+        if (!decodePostings(entries[i], next)) return markAll();
+        set_intersection(result.begin(), result.end(), next.begin(), next.end(), back_inserter(merged));
+        result.swap(merged);
+    }
+    for (uint32_t id : result) candidate[id] = 1;
+}
+
+// One pass of updateTrigramIndex. With reusePrevious, unchanged files take their postings
+// from the index already at indexPath; previousDamaged is set when one of those posting
+// lists does not decode, and nothing is written then.
+static bool buildTrigramIndex(const string& baseDir, const vector<string>& paths, const string& indexPath,
+                              size_t threads, TrigramIndexStats& stats, bool reusePrevious, bool& previousDamaged) {
+    stats = TrigramIndexStats();
+    previousDamaged = false;
+    string tempPath = indexPath + ".tmp";
+    string prefix = baseDir.empty() || baseDir.back() == '/' ? baseDir : baseDir + "/";
+
+    // The file table is sorted by path so lookups can binary search it.
+    vector<string> sorted;
+    for (const string& path : paths)
+        if (prefix + path != indexPath && prefix + path != tempPath) sorted.push_back(path);
+    sort(sorted.begin(), sorted.end());
+    sorted.erase(unique(sorted.begin(), sorted.end()), sorted.end());
+
+    struct Scan {
+        bool kept = false;
+        int64_t mtime = 0;
+        uint64_t size = 0;
+        uint32_t flags = 0;
+        int64_t oldId = -1;         // reused from the previous index
+        vector<uint32_t> trigrams;  // freshly collected
+    };
+    vector<Scan> scans(sorted.size());
+    TrigramIndex previous(reusePrevious ? indexPath : string());
+
+    {
+        ThreadPool pool(std::min(threads, std::max<size_t>(sorted.size(), 1)));
+        for (size_t i = 0; i < sorted.size(); i++) {
+            pool.submit([&, i] {
+                Scan& scan = scans[i];
+                string fullPath = prefix + sorted[i];
+                struct stat info;
+                if (stat(fullPath.c_str(), &info) != 0 || !S_ISREG(info.st_mode)) return;
+                scan.mtime = mtimeNanos(info);
+                scan.size = info.st_size;
+                scan.oldId = previous.currentId(sorted[i], fullPath);
+                if (scan.oldId >= 0) {
+                    scan.kept = true;
+                    if (previous.isBinary(scan.oldId)) scan.flags |= TRIGRAM_FILE_BINARY;
+                    return;
+                }
+                MappedFile file(fullPath);
+                if (!file.isOpen()) return;
+                scan.kept = true;
+                if (looksBinary(file.data(), file.size())) {
+                    scan.flags |= TRIGRAM_FILE_BINARY;
+                    return;
+                }
+                collectTrigrams(reinterpret_cast<const unsigned char*>(file.data()), file.size(), scan.trigrams);
+            });
+        }
+        pool.wait();
+    }
+
+    // New ids follow the sorted order; postings of unchanged files are carried over
+    // from the previous index through an old-id -> new-id map.
+    vector<int64_t> remap(previous.isOpen() ? previous.fileCount() : 0, -1);
+    vector<size_t> kept;
+    for (size_t i = 0; i < scans.size(); i++) {
+        if (!scans[i].kept) continue;
+        if (scans[i].oldId >= 0) {
+            remap[scans[i].oldId] = kept.size();
+            stats.reused++;
+        } else {
+            stats.scanned++;
+            stats.bytesScanned += scans[i].size;
+        }
+        if (scans[i].flags & TRIGRAM_FILE_BINARY) stats.binaries++;
+        kept.push_back(i);
+    }
+
+    unordered_map<uint32_t, vector<uint32_t>> postings;
+    if (stats.reused > 0) {
+        vector<uint32_t> ids;
+        for (size_t n = 0; n < previous.trigramCount(); n++) {
+            uint32_t trigram;
+            ids.clear();
+            if (!previous.postings(n, trigram, ids)) {
+                previousDamaged = true;
+                return false;
+            }
+            for (uint32_t id : ids)
+                if (remap[id] >= 0) postings[trigram].push_back(static_cast<uint32_t>(remap[id]));
+        }
+    }
+    for (size_t id = 0; id < kept.size(); id++) {
+        for (uint32_t trigram : scans[kept[id]].trigrams) postings[trigram].push_back(static_cast<uint32_t>(id));
+        vector<uint32_t>().swap(scans[kept[id]].trigrams);
+    }
+
+    vector<uint32_t> order;
+    order.reserve(postings.size());
+    for (auto& [trigram, ids] : postings) {
+        order.push_back(trigram);
+        sort(ids.begin(), ids.end());
+    }
+    sort(order.begin(), order.end());
+
+    string pathBlob, postingBlob, out;
+    for (size_t i : kept) pathBlob += sorted[i];
+    string trigramTable;
+    for (uint32_t trigram : order) {
+        const vector<uint32_t>& ids = postings[trigram];
+        putLE(trigramTable, trigram, 4);
+        putLE(trigramTable, ids.size(), 4);
+        putLE(trigramTable, postingBlob.size(), 8);
+        uint32_t last = 0;
+        for (uint32_t id : ids) {
+            uint32_t gap = id - last;
+            last = id;
+            while (gap >= 0x80) {
+                postingBlob += static_cast<char>((gap & 0x7F) | 0x80);
+                gap >>= 7;
+            }
+            postingBlob += static_cast<char>(gap);
+        }
+    }
+
+    uint64_t pathsOffset = TRIGRAM_HEADER_SIZE + kept.size() * TRIGRAM_FILE_ENTRY_SIZE + trigramTable.size();
+    out += "BTRI";
+    putLE(out, TRIGRAM_INDEX_VERSION, 4);
+    putLE(out, kept.size(), 4);
+    putLE(out, order.size(), 4);
+    putLE(out, pathsOffset, 8);
+    putLE(out, pathsOffset + pathBlob.size(), 8);
+    uint32_t pathOffset = 0;
+    for (size_t i : kept) {
+        putLE(out, scans[i].mtime, 8);
+        putLE(out, scans[i].size, 8);
+        putLE(out, pathOffset, 4);
+        putLE(out, sorted[i].size(), 4);
+        putLE(out, scans[i].flags, 4);
+        putLE(out, 0, 4);
+        pathOffset += sorted[i].size();
+    }
+    out += trigramTable;
+    out += pathBlob;
+    out += postingBlob;
+
+    // Written beside the old index and renamed over it, so a reader (or a crash) never
+    // sees half an index, and the old mapping stays valid until it is dropped.
+    bool written;
+    {
+        ofstream file(tempPath, ios::binary | ios::trunc);
+        written = static_cast<bool>(file.write(out.data(), out.size()));
+    }
+    if (!written || rename(tempPath.c_str(), indexPath.c_str()) != 0) {
+        remove(tempPath.c_str());
+        return false;
+    }
+    stats.files = kept.size();
+    stats.trigrams = order.size();
+    stats.indexBytes = out.size();
+    return true;
+}
+
+bool updateTrigramIndex(const string& baseDir, const vector<string>& paths, const string& indexPath,
+                        size_t threads, TrigramIndexStats& stats) {
+    bool previousDamaged;
+    if (buildTrigramIndex(baseDir, paths, indexPath, threads, stats, true, previousDamaged)) return true;
+    // Keeping a damaged index would fail every later update the same way: read every file
+    // again and write a fresh index over it.
+    return previousDamaged && buildTrigramIndex(baseDir, paths, indexPath, threads, stats, false, previousDamaged);
+}
@@ -0,0 +1,94 @@
+// Block-parallel container (version 2): round trips, corrupt block tables that must be
+// rejected before anything is allocated for them, and file codecs writing over their input.
+#include "huffman.h"
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+
+using namespace std;
+
+static int failures = 0;
+
+static void check(bool condition, const string& what) {
+    if (!condition) {
+        printf("FAIL: %s\n", what.c_str());
+        failures++;
+    }
+}
+
+static void setLE(string& data, size_t pos, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) data[pos + i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+}
+
+// Runs both decoders (in memory and streaming from a file) over data.
+static bool decodes(const string& data, string& output) {
+    bool inMemory = decompressHuffman(data, output, 4);
+    const string input = "huffman_test.in", result = "huffman_test.out";
+    ofstream(input, ios::binary).write(data.data(), data.size());
+    uint64_t originalBytes = 0, compressedBytes = 0;
+    bool streamed = decompressHuffmanFile(input, result, originalBytes, compressedBytes, 4);
+    remove(input.c_str());
+    remove(result.c_str());
+    check(inMemory == streamed, "in-memory and streaming decoders disagree");
+    return inMemory;
+}
+
+static string readFile(const string& path) {
+    stringstream contents;
+    contents << ifstream(path, ios::binary).rdbuf();
+    return contents.str();
+}
+
+int main() {
+    string text;
+    for (int i = 0; i < 20000; i++) text += "bhai " + to_string(i % 97) + (i % 7 ? " " : "\n");
+
+    for (uint8_t codec : {HUFFMAN_CODEC_ORDER0, HUFFMAN_CODEC_LZ77}) {
+        string packed = compressHuffmanBlocks(text, 4096, 4, codec), output;
+        check(decodes(packed, output) && output == text, "round trip");
+
+        // A block claiming more raw bytes than the block size.
+        string oversized = packed;
+        setLE(oversized, HUFFMAN_BLOCKED_HEADER_SIZE, 0xFFFFFFFFu, 4);
+        setLE(oversized, 8, text.size() - 4096 + 0xFFFFFFFFull, 8);
+        check(!decodes(oversized, output), "raw length over the block size");
+
+        // A huge original length and block size, with one block table entry to match.
+        string huge = packed.substr(0, HUFFMAN_BLOCKED_HEADER_SIZE + HUFFMAN_BLOCK_HEADER_SIZE);
+        setLE(huge, 8, 0xFFFFFFFFull * 64, 8);
+        setLE(huge, 16, 0xFFFFFFFFu, 4);
+        setLE(huge, HUFFMAN_BLOCKED_HEADER_SIZE, 0xFFFFFFFFu, 4);
+        setLE(huge, HUFFMAN_BLOCKED_HEADER_SIZE + 4, 0, 4);
+        huge.resize(532, '\0');
+        check(!decodes(huge, output), "original length over what the payload can hold");
+
+        // Block table cut off in the middle.
+        string truncated = packed.substr(0, packed.size() / 2);
+        check(!decodes(truncated, output), "truncated block table");
+    }
+
+    // Compressing and decompressing a file onto itself must not truncate it before it is read.
+    const string input = "huffman_test.in", result = "huffman_test.out";
+    const string tempPath = result + "." + to_string(getpid()) + ".tmp";
+    ofstream(input, ios::binary) << text;
+    uint64_t originalBytes = 0, compressedBytes = 0;
+    check(compressHuffmanFile(input, input, originalBytes, compressedBytes, 4), "compress in place");
+    check(decompressHuffmanFile(input, input, originalBytes, compressedBytes, 4) && readFile(input) == text,
+          "decompress in place");
+
+    // A failed decode leaves an existing output untouched and no temporary behind.
+    string packed = compressHuffmanBlocks(text, 4096, 4);
+    ofstream(input, ios::binary) << packed.substr(0, packed.size() - 100);
+    ofstream(result, ios::binary) << "pehle se";
+    check(!decompressHuffmanFile(input, result, originalBytes, compressedBytes, 4), "truncated payload");
+    check(readFile(result) == "pehle se", "output kept after a failed decode");
+    check(!ifstream(tempPath), "temporary removed after a failed decode");
+    remove(input.c_str());
+    remove(result.c_str());
+
+    if (failures) return 1;
+    printf("huffman_test: ok\n");
+    return 0;
+}
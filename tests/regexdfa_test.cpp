@@ -0,0 +1,66 @@
+// dhoondo -x matching: leftmost-longest results, empty matches, and the linear bound on a
+// long line where almost every byte could start a match.
+#include "regexdfa.h"
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+static int failures = 0;
+
+static void check(bool condition, const string& what) {
+    if (!condition) {
+        printf("FAIL: %s\n", what.c_str());
+        failures++;
+    }
+}
+
+// Every match, walked the way dhoondo walks them.
+static vector<pair<size_t, size_t>> allMatches(RegexSearcher& searcher, const string& text) {
+    vector<pair<size_t, size_t>> found;
+    size_t from = 0, start, end;
+    while (from <= text.size() && searcher.nextMatch(text.data(), text.size(), from, start, end)) {
+        found.push_back({start, end});
+        from = end > start ? end : end + 1;
+    }
+    return found;
+}
+
+static vector<pair<size_t, size_t>> matches(const string& pattern, const string& text) {
+    RegexProgram program;
+    string error;
+    check(program.compile(pattern, error), "compile " + pattern);
+    RegexSearcher searcher(program);
+    return allMatches(searcher, text);
+}
+
+int main() {
+    using Spans = vector<pair<size_t, size_t>>;
+    check(matches("x.*y|x", "axbxcy") == Spans{{1, 6}}, "longest alternative wins");
+    check(matches("x.*y|x", "xx\nxy") == Spans{{0, 1}, {1, 2}, {3, 5}}, "one line at a time");
+    check(matches("^$", "a\n\nb\n") == Spans{{2, 2}}, "empty line");
+    check(matches("x?", "ax") == Spans{{0, 0}, {1, 2}, {2, 2}}, "empty matches around a real one");
+    check(matches("b+$", "abb\nbab") == Spans{{1, 3}, {6, 7}}, "anchored to line ends");
+
+    // A single long line where every byte starts a match whose longest form would need a
+    // 'y' that never comes: each byte must be stepped a bounded number of times.
+    for (const char* pattern : {"x.*y|x", "x[^y]*y|x", "(a|x)+z|x"}) {
+        RegexProgram program;
+        string error;
+        program.compile(pattern, error);
+        RegexSearcher searcher(program);
+        const size_t length = 200000;
+        string line(length, 'x');
+        size_t found = allMatches(searcher, line).size();
+        check(found == length, string(pattern) + ": one match per byte");
+        check(searcher.anchoredSteps() <= 4 * length,
+              string(pattern) + ": " + to_string(searcher.anchoredSteps()) + " anchored steps for " +
+                  to_string(length) + " bytes");
+    }
+
+    if (failures) return 1;
+    printf("regexdfa_test: ok\n");
+    return 0;
+}
@@ -0,0 +1,75 @@
+// suchi index: a fresh build, an incremental update that reuses postings, and an update
+// over an index whose posting lists were damaged, which must rebuild it.
+#include "trigramindex.h"
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+static int failures = 0;
+
+static void check(bool condition, const string& what) {
+    if (!condition) {
+        printf("FAIL: %s\n", what.c_str());
+        failures++;
+    }
+}
+
+static size_t candidates(const string& indexPath, const string& pattern) {
+    TrigramIndex index(indexPath);
+    vector<uint8_t> candidate;
+    index.markCandidates(pattern, candidate);
+    size_t count = 0;
+    for (uint8_t c : candidate) count += c;
+    return count;
+}
+
+int main() {
+    const string dir = "trigramindex_test." + to_string(getpid());
+    const string indexPath = dir + "/" + TRIGRAM_INDEX_FILE;
+    mkdir(dir.c_str(), 0755);
+    vector<string> paths;
+    for (int i = 0; i < 20; i++) {
+        paths.push_back("file" + to_string(i) + ".txt");
+        ofstream(dir + "/" + paths.back()) << "bhai number " << i << (i % 4 ? " chai\n" : " samosa\n");
+    }
+
+    TrigramIndexStats stats;
+    check(updateTrigramIndex(dir, paths, indexPath, 2, stats) && stats.scanned == 20, "fresh build");
+    check(candidates(indexPath, "samosa") == 5, "candidates after a fresh build");
+    check(updateTrigramIndex(dir, paths, indexPath, 2, stats) && stats.reused == 20 && stats.scanned == 0,
+          "unchanged files are reused");
+
+    // Every posting byte becomes a varint continuation byte, so each list runs off the end.
+    {
+        fstream index(indexPath, ios::in | ios::out | ios::binary);
+        unsigned char header[TRIGRAM_HEADER_SIZE];
+        index.read(reinterpret_cast<char*>(header), sizeof(header));
+        uint64_t postingsOffset = 0;
+        for (int i = 7; i >= 0; i--) postingsOffset = postingsOffset << 8 | header[24 + i];
+        index.seekg(0, ios::end);
+        uint64_t size = index.tellg();
+        index.seekp(postingsOffset);
+        index << string(size - postingsOffset, '\x80');
+    }
+    vector<uint32_t> ids;
+    uint32_t trigram;
+    check(!TrigramIndex(indexPath).postings(0, trigram, ids), "postings are damaged");
+
+    check(updateTrigramIndex(dir, paths, indexPath, 2, stats), "update over a damaged index");
+    check(stats.reused == 0 && stats.scanned == 20, "damaged index rebuilt from the files");
+    check(TrigramIndex(indexPath).postings(0, trigram, ids), "rebuilt postings decode");
+    check(candidates(indexPath, "samosa") == 5 && candidates(indexPath, "chai") == 15, "candidates after the rebuild");
+
+    for (const string& path : paths) remove((dir + "/" + path).c_str());
+    remove(indexPath.c_str());
+    rmdir(dir.c_str());
+
+    if (failures) return 1;
+    printf("trigramindex_test: ok\n");
+    return 0;
+}